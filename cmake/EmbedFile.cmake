@@ -0,0 +1,23 @@
+# Turns a binary file into a C++ source defining it as a byte array.
+#
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<file.cpp> -DSYMBOL=<name> -P EmbedFile.cmake
+#
+# Defines hash::<SYMBOL> (the bytes) and hash::<SYMBOL>Size.
+
+file(READ "${INPUT}" content HEX)
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," content "${content}")
+string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)" "\\1\n" content "${content}")
+
+file(WRITE "${OUTPUT}"
+"// Generated by cmake/EmbedFile.cmake from ${INPUT} - do not edit
+#include <cstddef>
+
+namespace hash {
+
+alignas(16) extern const unsigned char ${SYMBOL}[] = {
+${content}
+};
+extern const size_t ${SYMBOL}Size = sizeof(${SYMBOL});
+
+} // namespace hash
+")
@@ -0,0 +1,165 @@
+#include "hashrt.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// This file is compiled twice: into the libhashrt static library and into
+// LLVM bitcode that hashc links into every module it compiles. Keep it
+// free of C++ runtime dependencies (no exceptions, RTTI or iostreams) so
+// the bitcode only ever calls into libc.
+
+namespace {
+
+// Returned instead of NULL when a string builtin has nothing to give back
+char* emptyString() {
+    return const_cast<char*>("");
+}
+
+// ASCII case conversion: flips the case bit of every byte in [first, last].
+// The body is branch-free so the loop vectorizes for whatever CPU the
+// module is compiled for.
+char* convertCase(const char* str, unsigned char first, unsigned char last) {
+    size_t length = std::strlen(str);
+    char* result = static_cast<char*>(std::malloc(length + 1));
+    unsigned char span = static_cast<unsigned char>(last - first);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        unsigned char inRange = static_cast<unsigned char>(c - first) <= span;
+        result[i] = static_cast<char>(c ^ (inRange << 5));
+    }
+    result[length] = '\0';
+    return result;
+}
+
+} // namespace
+
+// ========================================
+// Strings
+// ========================================
+
+int32_t hashrt_len(const char* str) {
+    return static_cast<int32_t>(std::strlen(str));
+}
+
+char* hashrt_str_concat(const char* left, const char* right) {
+    // Measure each side once and copy with memcpy instead of strcpy+strcat,
+    // which rescans the left string
+    size_t leftLength = std::strlen(left);
+    size_t rightLength = std::strlen(right);
+    char* result = static_cast<char*>(std::malloc(leftLength + rightLength + 1));
+    std::memcpy(result, left, leftLength);
+    std::memcpy(result + leftLength, right, rightLength + 1);
+    return result;
+}
+
+bool hashrt_str_eq(const char* left, const char* right) {
+    return std::strcmp(left, right) == 0;
+}
+
+char* hashrt_upper(const char* str) {
+    return convertCase(str, 'a', 'z');
+}
+
+char* hashrt_lower(const char* str) {
+    return convertCase(str, 'A', 'Z');
+}
+
+// ========================================
+// File I/O
+// ========================================
+
+char* hashrt_file_read(const char* path) {
+#ifdef _WIN32
+    FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        return emptyString();
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    char* buffer = static_cast<char*>(std::malloc(size + 1));
+    size_t total = std::fread(buffer, 1, size, file);
+    std::fclose(file);
+#else
+    // One fstat for the size and plain read()s straight into the result,
+    // with no stdio buffering or seeking
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return emptyString();
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return emptyString();
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    char* buffer = static_cast<char*>(std::malloc(size + 1));
+    size_t total = 0;
+    while (total < size) {
+        ssize_t count = read(fd, buffer + total, size - total);
+        if (count <= 0) {
+            break;
+        }
+        total += static_cast<size_t>(count);
+    }
+    close(fd);
+#endif
+    buffer[total] = '\0';
+    return buffer;
+}
+
+bool hashrt_file_write(const char* path, const char* content) {
+    FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    std::fwrite(content, 1, std::strlen(content), file);
+    std::fclose(file);
+    return true;
+}
+
+bool hashrt_file_exists(const char* path) {
+#ifdef _WIN32
+    return _access(path, 0) == 0;
+#else
+    return access(path, F_OK) == 0;
+#endif
+}
+
+bool hashrt_file_delete(const char* path) {
+    return std::remove(path) == 0;
+}
+
+// ========================================
+// Time and random numbers
+// ========================================
+
+int64_t hashrt_time() {
+    return static_cast<int64_t>(std::time(nullptr));
+}
+
+double hashrt_clock() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+double hashrt_random() {
+    // [0.0, 1.0) using the platform's real RAND_MAX
+    return std::rand() / (static_cast<double>(RAND_MAX) + 1.0);
+}
+
+void hashrt_seed_random(int32_t seed) {
+    std::srand(static_cast<unsigned>(seed));
+}
+
+int32_t hashrt_random_range(int32_t min, int32_t max) {
+    return min + std::rand() % (max - min + 1);
+}
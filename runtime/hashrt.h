@@ -0,0 +1,35 @@
+#ifndef HASH_RUNTIME_H
+#define HASH_RUNTIME_H
+
+#include <cstdint>
+
+// C ABI of libhashrt, the runtime behind Hash's string, file, time and
+// random builtins. A call to builtin `name` is emitted as a call to
+// hashrt_name; CodeGenerator links the definitions in from the embedded
+// bitcode so they can inline, and the static library resolves anything
+// that was not linked that way.
+extern "C" {
+
+// Strings
+int32_t hashrt_len(const char* str);
+char* hashrt_str_concat(const char* left, const char* right);
+bool hashrt_str_eq(const char* left, const char* right);
+char* hashrt_upper(const char* str);
+char* hashrt_lower(const char* str);
+
+// File I/O
+char* hashrt_file_read(const char* path);
+bool hashrt_file_write(const char* path, const char* content);
+bool hashrt_file_exists(const char* path);
+bool hashrt_file_delete(const char* path);
+
+// Time and random numbers
+int64_t hashrt_time();
+double hashrt_clock();
+double hashrt_random();
+void hashrt_seed_random(int32_t seed);
+int32_t hashrt_random_range(int32_t min, int32_t max);
+
+}
+
+#endif // HASH_RUNTIME_H
@@ -1,7 +1,117 @@
 #include "ast.h"
+#include <algorithm>
+#include <iterator>
 
 namespace hash {
 
+const Type* Type::get(Kind kind) {
+    return TypeContext::get().getPrimitive(kind);
+}
+
+TypeContext& TypeContext::get() {
+    static TypeContext context;
+    return context;
+}
+
+TypeContext::TypeContext() {
+    for (int kind = 0; kind <= static_cast<int>(Type::Kind::STR); kind++) {
+        primitives[kind].reset(new Type(static_cast<Type::Kind>(kind)));
+    }
+}
+
+const Type* TypeContext::getPrimitive(Type::Kind kind) const {
+    return primitives[static_cast<int>(kind)].get();
+}
+
+const Type* TypeContext::getPointer(const Type* element) {
+    return getComposite({Type::Kind::POINTER, element, -1, {}, ""});
+}
+
+const Type* TypeContext::getArray(const Type* element, int size) {
+    return getComposite({Type::Kind::ARRAY, element, size, {}, ""});
+}
+
+const Type* TypeContext::getFunction(const Type* returnType, const std::vector<const Type*>& paramTypes) {
+    return getComposite({Type::Kind::FUNCTION, returnType, -1, paramTypes, ""});
+}
+
+const Type* TypeContext::getStruct(const std::string& name) {
+    return getComposite({Type::Kind::STRUCT, nullptr, -1, {}, name});
+}
+
+size_t TypeContext::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<int>()(static_cast<int>(key.kind));
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    };
+    combine(std::hash<const Type*>()(key.element));
+    combine(std::hash<int>()(key.size));
+    for (const Type* param : key.params) {
+        combine(std::hash<const Type*>()(param));
+    }
+    combine(std::hash<std::string>()(key.name));
+    return hash;
+}
+
+const Type* TypeContext::getComposite(Key key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = composites.find(key);
+    if (it != composites.end()) {
+        return it->second.get();
+    }
+    
+    std::unique_ptr<Type> type(new Type(key.kind));
+    if (key.kind == Type::Kind::FUNCTION) {
+        type->returnType = key.element;
+        type->paramTypes = key.params;
+    } else {
+        type->elementType = key.element;
+    }
+    type->arraySize = key.size;
+    type->structName = key.name;
+    
+    const Type* result = type.get();
+    composites.emplace(std::move(key), std::move(type));
+    return result;
+}
+
+ASTContext::~ASTContext() {
+    // Newest first, like the stack of objects they were created as
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->second(it->first);
+    }
+}
+
+void ASTContext::adopt(ASTContext& other) {
+    slabs.insert(slabs.end(), std::make_move_iterator(other.slabs.begin()),
+                 std::make_move_iterator(other.slabs.end()));
+    destructors.insert(destructors.end(), other.destructors.begin(), other.destructors.end());
+    bytesAllocated += other.bytesAllocated;
+    
+    other.slabs.clear();
+    other.destructors.clear();
+    other.cursor = nullptr;
+    other.slabEnd = nullptr;
+    other.bytesAllocated = 0;
+}
+
+void* ASTContext::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    if (!cursor || padding + size > static_cast<size_t>(slabEnd - cursor)) {
+        // Oversized requests get a slab of their own
+        size_t capacity = std::max(slabSize, size + alignment);
+        slabs.push_back(std::unique_ptr<char[]>(new char[capacity]));
+        cursor = slabs.back().get();
+        slabEnd = cursor + capacity;
+        padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+    }
+    
+    void* memory = cursor + padding;
+    cursor += padding + size;
+    bytesAllocated += size;
+    return memory;
+}
+
 // Expression implementations
 void IntegerLiteral::accept(ASTVisitor& visitor) { visitor.visit(*this); }
 void FloatLiteral::accept(ASTVisitor& visitor) { visitor.visit(*this); }
@@ -24,4 +134,17 @@ void ExprStmt::accept(ASTVisitor& visitor) { visitor.visit(*this); }
 void FunctionDecl::accept(ASTVisitor& visitor) { visitor.visit(*this); }
 void Program::accept(ASTVisitor& visitor) { visitor.visit(*this); }
 
+void ExpressionWalker::walk(Expression& root, ASTVisitor& visitor) {
+    // Frames below base belong to a walk this one is nested in, if any
+    size_t base = frames.size();
+    frames.push_back({&root, 0});
+    while (frames.size() > base) {
+        size_t depth = frames.size();
+        frames.back().node->accept(visitor);
+        if (frames.size() == depth) {
+            frames.pop_back();
+        }
+    }
+}
+
 } // namespace hash
@@ -1,8 +1,16 @@
 #ifndef HASH_AST_H
 #define HASH_AST_H
 
+#include "identifiers.h"
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace hash {
@@ -10,17 +18,90 @@ namespace hash {
 // Forward declarations
 class ASTVisitor;
 
-// Base class for all AST nodes
+// Base class for all AST nodes. Nodes live in an ASTContext and are never
+// deleted one by one, hence no virtual destructor.
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
     virtual void accept(ASTVisitor& visitor) = 0;
     
     int line = 0;
     int column = 0;
+    
+protected:
+    ~ASTNode() = default;
+};
+
+// A fixed list of children stored contiguously in an ASTContext
+template <typename T>
+class NodeList {
+public:
+    NodeList() = default;
+    NodeList(T* items, uint32_t count) : items(items), count(count) {}
+    
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t index) const { return items[index]; }
+    T& back() const { return items[count - 1]; }
+    
+private:
+    T* items = nullptr;
+    uint32_t count = 0;
+};
+
+// Owns every node of one parsed file. Nodes are bump-allocated from large
+// slabs, refer to each other by plain pointers and are all freed at once
+// with the context. Only node types that hold strings need their
+// destructors run; the rest are simply dropped with their slab.
+class ASTContext {
+public:
+    ASTContext() = default;
+    ASTContext(const ASTContext&) = delete;
+    ASTContext& operator=(const ASTContext&) = delete;
+    ~ASTContext();
+    
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.emplace_back(node, [](void* object) { static_cast<T*>(object)->~T(); });
+        }
+        return node;
+    }
+    
+    // Copies items [first, last) of a vector into the arena
+    template <typename T>
+    NodeList<T> list(const std::vector<T>& items, size_t first = 0) {
+        static_assert(std::is_trivially_copyable_v<T>, "lists hold node pointers");
+        size_t count = items.size() - first;
+        if (count == 0) return NodeList<T>();
+        T* copy = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::uninitialized_copy(items.begin() + first, items.end(), copy);
+        return NodeList<T>(copy, static_cast<uint32_t>(count));
+    }
+    
+    size_t getBytesAllocated() const { return bytesAllocated; }
+    
+    // Takes over the nodes of other, which stay where they are, so pieces
+    // of a program parsed separately can be joined into one
+    void adopt(ASTContext& other);
+    
+private:
+    static constexpr size_t slabSize = 64 * 1024;
+    
+    std::vector<std::unique_ptr<char[]>> slabs;
+    char* cursor = nullptr;
+    char* slabEnd = nullptr;
+    size_t bytesAllocated = 0;
+    std::vector<std::pair<void*, void (*)(void*)>> destructors;
+    
+    void* allocate(size_t size, size_t alignment);
 };
 
-// Type representation
+// Type representation. Types are unique: each is created once, by
+// TypeContext, so two types are the same type exactly when they are the
+// same object and can be compared by pointer.
 struct Type {
     enum class Kind {
         I8, I16, I32, I64,
@@ -31,26 +112,93 @@ struct Type {
     };
     
     Kind kind;
-    std::shared_ptr<Type> elementType; // For pointers and arrays
-    std::vector<std::shared_ptr<Type>> paramTypes; // For functions
-    std::shared_ptr<Type> returnType; // For functions
+    const Type* elementType = nullptr; // For pointers and arrays
+    std::vector<const Type*> paramTypes; // For functions
+    const Type* returnType = nullptr; // For functions
     std::string structName; // For struct types
     int arraySize = -1; // For arrays (-1 means dynamic/unknown size)
     
-    Type(Kind k) : kind(k) {}
+    Type(const Type&) = delete;
+    Type& operator=(const Type&) = delete;
+    
+    // The singleton of a primitive kind (I8 through STR)
+    static const Type* get(Kind kind);
+    static const Type* getI32() { return get(Kind::I32); }
+    static const Type* getI64() { return get(Kind::I64); }
+    static const Type* getF64() { return get(Kind::F64); }
+    static const Type* getBool() { return get(Kind::BOOL); }
+    static const Type* getVoid() { return get(Kind::VOID); }
+    static const Type* getStr() { return get(Kind::STR); }
     
-    static std::shared_ptr<Type> getI32() { return std::make_shared<Type>(Kind::I32); }
-    static std::shared_ptr<Type> getI64() { return std::make_shared<Type>(Kind::I64); }
-    static std::shared_ptr<Type> getF64() { return std::make_shared<Type>(Kind::F64); }
-    static std::shared_ptr<Type> getBool() { return std::make_shared<Type>(Kind::BOOL); }
-    static std::shared_ptr<Type> getVoid() { return std::make_shared<Type>(Kind::VOID); }
-    static std::shared_ptr<Type> getStr() { return std::make_shared<Type>(Kind::STR); }
+private:
+    friend class TypeContext;
+    explicit Type(Kind k) : kind(k) {}
+};
+
+// Creates and uniques every type. Primitive types are static singletons;
+// composite types are hash-consed on first use and live for the rest of
+// the process, so types from different modules and threads compare equal
+// by pointer. Safe to use from several threads.
+class TypeContext {
+public:
+    static TypeContext& get();
+    
+    const Type* getPrimitive(Type::Kind kind) const;
+    const Type* getPointer(const Type* element);
+    const Type* getArray(const Type* element, int size);
+    const Type* getFunction(const Type* returnType, const std::vector<const Type*>& paramTypes);
+    const Type* getStruct(const std::string& name);
+    
+private:
+    // Everything that makes a composite type distinct
+    struct Key {
+        Type::Kind kind;
+        const Type* element;
+        int size;
+        std::vector<const Type*> params;
+        std::string name;
+        
+        bool operator==(const Key& other) const {
+            return kind == other.kind && element == other.element && size == other.size &&
+                   params == other.params && name == other.name;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    
+    std::mutex mutex;
+    std::unordered_map<Key, std::unique_ptr<Type>, KeyHash> composites;
+    
+    TypeContext();
+    const Type* getComposite(Key key);
+    
+    std::unique_ptr<Type> primitives[static_cast<int>(Type::Kind::STR) + 1];
+};
+
+// What a name refers to. SemanticAnalyzer resolves every variable use,
+// declaration and call, so code generation never looks a name up again.
+struct Binding {
+    enum class Kind {
+        UNRESOLVED,
+        LOCAL,    // Parameter or local: slot in the enclosing function
+        GLOBAL,   // Index into Program::globals
+        FUNCTION, // Index into Program::functions
+        IMPORTED, // Index into the functions imported from other modules
+        BUILTIN   // A Builtin
+    };
+    
+    Kind kind = Kind::UNRESOLVED;
+    uint32_t index = 0;
+    
+    Binding() = default;
+    Binding(Kind k, uint32_t i) : kind(k), index(i) {}
 };
 
 // Expression nodes
 class Expression : public ASTNode {
 public:
-    std::shared_ptr<Type> type;
+    const Type* type = nullptr;
 };
 
 class IntegerLiteral : public Expression {
@@ -81,10 +229,13 @@ public:
     void accept(ASTVisitor& visitor) override;
 };
 
+// Named nodes store only the IdentifierId of their name; its spelling is in
+// the program's IdentifierTable (see Program::getName)
 class Identifier : public Expression {
 public:
-    std::string name;
-    Identifier(const std::string& n) : name(n) {}
+    IdentifierId id;
+    Binding binding;
+    explicit Identifier(IdentifierId id) : id(id) {}
     void accept(ASTVisitor& visitor) override;
 };
 
@@ -99,10 +250,10 @@ public:
     };
     
     Op op;
-    std::shared_ptr<Expression> left;
-    std::shared_ptr<Expression> right;
+    Expression* left;
+    Expression* right;
     
-    BinaryOp(Op o, std::shared_ptr<Expression> l, std::shared_ptr<Expression> r)
+    BinaryOp(Op o, Expression* l, Expression* r)
         : op(o), left(l), right(r) {}
     void accept(ASTVisitor& visitor) override;
 };
@@ -112,19 +263,20 @@ public:
     enum class Op { NEG, NOT, BIT_NOT };
     
     Op op;
-    std::shared_ptr<Expression> operand;
+    Expression* operand;
     
-    UnaryOp(Op o, std::shared_ptr<Expression> operand)
+    UnaryOp(Op o, Expression* operand)
         : op(o), operand(operand) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class CallExpr : public Expression {
 public:
-    std::string functionName;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    IdentifierId functionId;
+    Binding binding;
+    NodeList<Expression*> arguments;
     
-    CallExpr(const std::string& name) : functionName(name) {}
+    explicit CallExpr(IdentifierId id) : functionId(id) {}
     void accept(ASTVisitor& visitor) override;
 };
 
@@ -134,90 +286,112 @@ class Statement : public ASTNode {
 
 class VariableDecl : public Statement {
 public:
-    std::string name;
-    std::shared_ptr<Type> varType;
-    std::shared_ptr<Expression> initializer;
+    IdentifierId id;
+    Binding binding; // LOCAL or GLOBAL
+    const Type* varType;
+    Expression* initializer = nullptr;
     bool isMutable;
     bool isPureLocal; // Behavior-aware access control
     
-    VariableDecl(const std::string& n, std::shared_ptr<Type> t, bool mut = false, bool pureLocal = false)
-        : name(n), varType(t), isMutable(mut), isPureLocal(pureLocal) {}
+    VariableDecl(IdentifierId id, const Type* t, bool mut = false, bool pureLocal = false)
+        : id(id), varType(t), isMutable(mut), isPureLocal(pureLocal) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class Assignment : public Statement {
 public:
-    std::string name;
-    std::shared_ptr<Expression> value;
+    IdentifierId id;
+    Binding binding;
+    Expression* value;
     
-    Assignment(const std::string& n, std::shared_ptr<Expression> v)
-        : name(n), value(v) {}
+    Assignment(IdentifierId id, Expression* v)
+        : id(id), value(v) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class ReturnStmt : public Statement {
 public:
-    std::shared_ptr<Expression> value;
+    Expression* value;
     
-    ReturnStmt(std::shared_ptr<Expression> v = nullptr) : value(v) {}
+    ReturnStmt(Expression* v = nullptr) : value(v) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class IfStmt : public Statement {
 public:
-    std::shared_ptr<Expression> condition;
-    std::vector<std::shared_ptr<Statement>> thenBody;
-    std::vector<std::shared_ptr<Statement>> elseBody;
+    Expression* condition;
+    NodeList<Statement*> thenBody;
+    NodeList<Statement*> elseBody;
     
-    IfStmt(std::shared_ptr<Expression> cond) : condition(cond) {}
+    IfStmt(Expression* cond) : condition(cond) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class WhileStmt : public Statement {
 public:
-    std::shared_ptr<Expression> condition;
-    std::vector<std::shared_ptr<Statement>> body;
+    Expression* condition;
+    NodeList<Statement*> body;
     
-    WhileStmt(std::shared_ptr<Expression> cond) : condition(cond) {}
+    WhileStmt(Expression* cond) : condition(cond) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 class ExprStmt : public Statement {
 public:
-    std::shared_ptr<Expression> expression;
+    Expression* expression;
     
-    ExprStmt(std::shared_ptr<Expression> expr) : expression(expr) {}
+    ExprStmt(Expression* expr) : expression(expr) {}
     void accept(ASTVisitor& visitor) override;
 };
 
 // Function parameter
 struct Parameter {
-    std::string name;
-    std::shared_ptr<Type> type;
+    IdentifierId id;
+    const Type* type;
     
-    Parameter(const std::string& n, std::shared_ptr<Type> t)
-        : name(n), type(t) {}
+    Parameter(IdentifierId id, const Type* t)
+        : id(id), type(t) {}
 };
 
 // Function declaration
 class FunctionDecl : public ASTNode {
 public:
-    std::string name;
-    std::vector<Parameter> parameters;
-    std::shared_ptr<Type> returnType;
-    std::vector<std::shared_ptr<Statement>> body;
+    IdentifierId id;
+    NodeList<Parameter> parameters;
+    const Type* returnType = nullptr;
+    NodeList<Statement*> body;
     bool isPure; // Behavior-aware: pure function marker
+    // Slots of parameters and locals; parameters take the first ones
+    uint32_t localCount = 0;
     
-    FunctionDecl(const std::string& n, bool pure = false)
-        : name(n), isPure(pure) {}
+    explicit FunctionDecl(IdentifierId id, bool pure = false)
+        : id(id), isPure(pure) {}
     void accept(ASTVisitor& visitor) override;
 };
 
-// Program (top-level)
+// import utils / import utils.strings / import "lib/utils.hash"
+struct Import {
+    std::string path; // Relative path of the .hash file to load
+    int line;
+    int column;
+    
+    Import(const std::string& p, int l, int c)
+        : path(p), line(l), column(c) {}
+};
+
+// Program (top-level). Owns the context holding all of its nodes, so the
+// whole tree goes away with it.
 class Program : public ASTNode {
 public:
-    std::vector<std::shared_ptr<FunctionDecl>> functions;
-    std::vector<std::shared_ptr<VariableDecl>> globals;
+    ASTContext context;
+    // Spells the ids of the nodes; set by the parser and must outlive the
+    // program
+    const IdentifierTable* identifiers = nullptr;
+    std::vector<Import> imports;
+    std::vector<FunctionDecl*> functions;
+    std::vector<VariableDecl*> globals;
+    
+    const std::string& getName(IdentifierId id) const { return identifiers->getName(id); }
     
     void accept(ASTVisitor& visitor) override;
 };
@@ -247,6 +421,30 @@ public:
     virtual void visit(Program& node) = 0;
 };
 
+// Walks an expression tree with an explicit stack, so expressions nested as
+// deeply as the parser accepts do not overflow the call stack. A visitor's
+// methods for compound expressions are entered once before their first
+// operand and again after each one: stage() tells how many operands have
+// been walked so far and descend() hands out the next. A visit that returns
+// without descending has finished its node.
+class ExpressionWalker {
+public:
+    void walk(Expression& root, ASTVisitor& visitor);
+    
+    uint32_t stage() const { return frames.back().stage; }
+    void descend(Expression& operand) {
+        frames.back().stage++;
+        frames.push_back({&operand, 0});
+    }
+    
+private:
+    struct Frame {
+        Expression* node;
+        uint32_t stage;
+    };
+    std::vector<Frame> frames;
+};
+
 } // namespace hash
 
 #endif // HASH_AST_H
@@ -0,0 +1,52 @@
+#ifndef HASH_BUILTINS_H
+#define HASH_BUILTINS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hash {
+
+// Functions every program can call without declaring them. Calls are bound
+// to these by SemanticAnalyzer, so codegen switches on the enum instead of
+// comparing names.
+enum class Builtin : uint32_t {
+    // Console output
+    PrintI32, PrintI64, PrintF64, PrintBool, PrintStr, Println, Print,
+    // Type conversions
+    I32ToI64, I64ToI32, I32ToF64, F64ToI32, I64ToF64, F64ToI64, Int, Float,
+    // Math
+    AbsI32, MinI32, MaxI32, SqrtF64, Abs, Min, Max, Sqrt,
+    Pow, Floor, Ceil, Round, Sin, Cos, Tan, Asin, Acos, Atan,
+    Exp, Log, Log2, Log10,
+    // Input
+    ReadI32, ReadF64,
+    // System
+    Exit, HashTime, HashClock, Random, SeedRandom, RandomRange,
+    // Strings
+    Len, StrConcat, StrEq, Upper, Lower,
+    // Files
+    FileRead, FileWrite, FileExists, FileDelete,
+    Count
+};
+
+// The name programs call the builtin by
+inline const char* getBuiltinName(Builtin builtin) {
+    static const char* const names[] = {
+        "print_i32", "print_i64", "print_f64", "print_bool", "print_str", "println", "print",
+        "i32_to_i64", "i64_to_i32", "i32_to_f64", "f64_to_i32", "i64_to_f64", "f64_to_i64", "int", "float",
+        "abs_i32", "min_i32", "max_i32", "sqrt_f64", "abs", "min", "max", "sqrt",
+        "pow", "floor", "ceil", "round", "sin", "cos", "tan", "asin", "acos", "atan",
+        "exp", "log", "log2", "log10",
+        "read_i32", "read_f64",
+        "exit", "hash_time", "hash_clock", "random", "seed_random", "random_range",
+        "len", "str_concat", "str_eq", "upper", "lower",
+        "file_read", "file_write", "file_exists", "file_delete",
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Builtin::Count),
+                  "every builtin needs a name");
+    return names[static_cast<uint32_t>(builtin)];
+}
+
+} // namespace hash
+
+#endif // HASH_BUILTINS_H
@@ -0,0 +1,261 @@
+#include "cache.h"
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/xxhash.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace hash {
+
+namespace {
+
+const char* const statsFileName = "stats";
+const char* const tempFilePrefix = "tmp-";
+
+// Hands the object LLJIT compiles for a module to the compilation cache
+class JITObjectCache : public llvm::ObjectCache {
+public:
+    JITObjectCache(CompilationCache& cache, const std::string& key)
+        : cache(cache), key(key) {}
+
+    void notifyObjectCompiled(const llvm::Module*, llvm::MemoryBufferRef object) override {
+        cache.store(key, "jit.o", llvm::ArrayRef<char>(object.getBufferStart(), object.getBufferSize()));
+    }
+
+    // Hits are served before a module is ever built, so the JIT only
+    // reaches this on a miss
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override {
+        return nullptr;
+    }
+
+private:
+    CompilationCache& cache;
+    std::string key;
+};
+
+} // namespace
+
+CompilationCache::CompilationCache(const std::string& directory, uint64_t maxSize)
+    : directory(directory), maxSize(maxSize) {
+    llvm::sys::fs::create_directories(directory);
+}
+
+std::string CompilationCache::getDefaultDirectory() {
+    llvm::SmallString<128> path;
+    if (!llvm::sys::path::cache_directory(path)) {
+        llvm::sys::fs::current_path(path);
+        llvm::sys::path::append(path, ".hashc-cache");
+        return std::string(path);
+    }
+    llvm::sys::path::append(path, "hashc");
+    return std::string(path);
+}
+
+std::string CompilationCache::hashFile(const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return "";
+    }
+    llvm::ArrayRef<uint8_t> bytes(reinterpret_cast<const uint8_t*>((*buffer)->getBufferStart()),
+                                  (*buffer)->getBufferSize());
+    return llvm::utohexstr(llvm::xxh3_64bits(bytes), /*LowerCase=*/true);
+}
+
+// Anchors getMainExecutable on platforms that find the executable through
+// the address of one of its functions
+static void mainExecutableAnchor() {}
+
+const std::string& CompilationCache::getCompilerIdentity() {
+    // The version number is not bumped for every change to code generation,
+    // builtins or the runtime, so identify the build by its executable.
+    // xxh3 reads even a statically linked hashc in a few milliseconds.
+    static const std::string identity = []() {
+        std::string executable = llvm::sys::fs::getMainExecutable(
+            nullptr, reinterpret_cast<void*>(&mainExecutableAnchor));
+        std::string contents = hashFile(executable);
+        return contents.empty() ? "unknown" : contents;
+    }();
+    return identity;
+}
+
+std::string CompilationCache::computeKey(llvm::StringRef source, const std::vector<std::string>& options) {
+    llvm::SHA256 hasher;
+    // NUL-separate every field so adjacent values cannot run together
+    auto add = [&hasher](llvm::StringRef field) {
+        hasher.update(field);
+        hasher.update(llvm::StringRef("\0", 1));
+    };
+    add("hashc " + getCompilerIdentity());
+    add("llvm " LLVM_VERSION_STRING);
+    for (const auto& option : options) {
+        add(option);
+    }
+    add(source);
+    return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string CompilationCache::getEntryPath(const std::string& key, const std::string& kind) const {
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, key + "." + kind);
+    return std::string(path);
+}
+
+std::string CompilationCache::lookup(const std::string& key, const std::string& kind) {
+    std::string path = getEntryPath(key, kind);
+    std::error_code EC;
+    bool hit = fs::is_regular_file(path, EC);
+    recordLookup(hit);
+    if (!hit) {
+        return "";
+    }
+    // Mark the entry as recently used for eviction
+    fs::last_write_time(path, fs::file_time_type::clock::now(), EC);
+    return path;
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CompilationCache::lookupBuffer(const std::string& key, const std::string& kind) {
+    std::string path = lookup(key, kind);
+    if (path.empty()) {
+        return nullptr;
+    }
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+        return nullptr;
+    }
+    return std::move(*buffer);
+}
+
+bool CompilationCache::store(const std::string& key, const std::string& kind, llvm::ArrayRef<char> data) {
+    // Write under a unique name and rename into place, so concurrent
+    // compilers never see a partially written entry
+    llvm::SmallString<128> model(directory);
+    llvm::sys::path::append(model, std::string(tempFilePrefix) + "%%%%%%%%");
+    int fd;
+    llvm::SmallString<128> tempPath;
+    if (llvm::sys::fs::createUniqueFile(model, fd, tempPath)) {
+        return false;
+    }
+    {
+        llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+        out.write(data.data(), data.size());
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tempPath);
+            return false;
+        }
+    }
+    if (llvm::sys::fs::rename(tempPath, getEntryPath(key, kind))) {
+        llvm::sys::fs::remove(tempPath);
+        return false;
+    }
+    evict();
+    return true;
+}
+
+bool CompilationCache::storeFile(const std::string& key, const std::string& kind, const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return false;
+    }
+    llvm::StringRef data = (*buffer)->getBuffer();
+    return store(key, kind, llvm::ArrayRef<char>(data.data(), data.size()));
+}
+
+std::unique_ptr<llvm::ObjectCache> CompilationCache::createJITObjectCache(const std::string& key) {
+    return std::make_unique<JITObjectCache>(*this, key);
+}
+
+void CompilationCache::recordLookup(bool hit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::string statsPath = getEntryPath(statsFileName, "txt");
+    {
+        std::ifstream in(statsPath);
+        std::string label;
+        in >> label >> hits >> label >> misses;
+    }
+    (hit ? hits : misses)++;
+    std::ofstream out(statsPath, std::ios::trunc);
+    out << "hits " << hits << "\nmisses " << misses << "\n";
+}
+
+void CompilationCache::evict() {
+    std::lock_guard<std::mutex> lock(mutex);
+    struct Entry {
+        fs::path path;
+        fs::file_time_type lastUsed;
+        uintmax_t size;
+    };
+    std::vector<Entry> entries;
+    uint64_t totalSize = 0;
+
+    std::error_code EC;
+    for (const auto& file : fs::directory_iterator(directory, EC)) {
+        std::string name = file.path().filename().string();
+        if (!file.is_regular_file(EC) || name.rfind(statsFileName, 0) == 0 || name.rfind(tempFilePrefix, 0) == 0) {
+            continue;
+        }
+        Entry entry{file.path(), file.last_write_time(EC), file.file_size(EC)};
+        totalSize += entry.size;
+        entries.push_back(entry);
+    }
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.lastUsed < b.lastUsed;
+    });
+    for (const auto& entry : entries) {
+        if (totalSize <= maxSize) {
+            break;
+        }
+        if (fs::remove(entry.path, EC)) {
+            totalSize -= entry.size;
+        }
+    }
+}
+
+void CompilationCache::printStatistics(std::ostream& out) const {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    {
+        std::ifstream in(getEntryPath(statsFileName, "txt"));
+        std::string label;
+        in >> label >> hits >> label >> misses;
+    }
+
+    uint64_t entries = 0;
+    uint64_t totalSize = 0;
+    std::error_code EC;
+    for (const auto& file : fs::directory_iterator(directory, EC)) {
+        std::string name = file.path().filename().string();
+        if (!file.is_regular_file(EC) || name.rfind(statsFileName, 0) == 0 || name.rfind(tempFilePrefix, 0) == 0) {
+            continue;
+        }
+        entries++;
+        totalSize += file.file_size(EC);
+    }
+
+    uint64_t lookups = hits + misses;
+    out << "Cache directory: " << directory << "\n";
+    out << "  Hits:    " << hits;
+    if (lookups > 0) {
+        out << " (" << (hits * 100 / lookups) << "%)";
+    }
+    out << "\n";
+    out << "  Misses:  " << misses << "\n";
+    out << "  Entries: " << entries << "\n";
+    out << "  Size:    " << (totalSize / 1024) << " KiB of " << (maxSize / (1024 * 1024)) << " MiB\n";
+}
+
+} // namespace hash
@@ -0,0 +1,68 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace hash {
+
+// On-disk, content-addressed cache of compiler outputs.
+//
+// Entries are named by a SHA-256 key over the source bytes, the hashc build
+// and LLVM version, the target and every option that affects the output,
+// so a hit can skip the whole pipeline. Each entry is a single file in the
+// cache directory; hits refresh its modification time, and stores evict the
+// least recently used entries once the directory grows past its size cap.
+// Hit and miss counts persist in the directory across runs. One cache can
+// be shared by the threads of a batch compilation.
+class CompilationCache {
+public:
+    CompilationCache(const std::string& directory, uint64_t maxSize);
+
+    // <user cache dir>/hashc, e.g. ~/.cache/hashc
+    static std::string getDefaultDirectory();
+
+    // Key for a source file compiled with the given option strings
+    static std::string computeKey(llvm::StringRef source, const std::vector<std::string>& options);
+
+    // Identifies this hashc build by a hash of its executable, which also
+    // embeds the runtime bitcode. Part of every key; computed once.
+    static const std::string& getCompilerIdentity();
+    // Hash of a file's contents, or empty if it cannot be read
+    static std::string hashFile(const std::string& path);
+
+    // Path of the cached artifact of the given kind ("exe", "jit.o"), or
+    // empty on a miss. Counts toward the hit/miss statistics.
+    std::string lookup(const std::string& key, const std::string& kind);
+    std::unique_ptr<llvm::MemoryBuffer> lookupBuffer(const std::string& key, const std::string& kind);
+
+    bool store(const std::string& key, const std::string& kind, llvm::ArrayRef<char> data);
+    bool storeFile(const std::string& key, const std::string& kind, const std::string& path);
+
+    // Captures the object the JIT compiles for this key
+    std::unique_ptr<llvm::ObjectCache> createJITObjectCache(const std::string& key);
+
+    void printStatistics(std::ostream& out) const;
+
+private:
+    std::string directory;
+    uint64_t maxSize;
+    // Serializes the statistics file and eviction between threads
+    std::mutex mutex;
+
+    std::string getEntryPath(const std::string& key, const std::string& kind) const;
+    void recordLookup(bool hit);
+    void evict();
+};
+
+} // namespace hash
+
+#endif // HASH_CACHE_H
@@ -1,32 +1,128 @@
 #include "codegen.h"
+#include "hashrt.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Caching.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Threading.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/CodeGen/TargetPassConfig.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <algorithm>
 #include <optional>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <system_error>
+#include <thread>
+#include <unordered_set>
 
 namespace hash {
 
-CodeGenerator::CodeGenerator()
-    : context(std::make_unique<llvm::LLVMContext>()),
+#ifdef HASH_HAVE_RUNTIME_BITCODE
+// runtime/hashrt.cpp as LLVM bitcode, generated by cmake/EmbedFile.cmake
+extern const unsigned char hashrtBitcode[];
+extern const size_t hashrtBitcodeSize;
+#endif
+
+// Entry point runJIT adds around main, so every JIT object is called the same way
+static const char* const jitEntryName = "__hash_jit_main";
+
+// Builtins emitted inline at each call instead of being called
+static bool isMathBuiltin(Builtin builtin) {
+    switch (builtin) {
+        case Builtin::Pow:
+        case Builtin::Floor:
+        case Builtin::Ceil:
+        case Builtin::Round:
+        case Builtin::Sqrt:
+        case Builtin::Sin:
+        case Builtin::Cos:
+        case Builtin::Tan:
+        case Builtin::Asin:
+        case Builtin::Acos:
+        case Builtin::Atan:
+        case Builtin::Exp:
+        case Builtin::Log:
+        case Builtin::Log2:
+        case Builtin::Log10:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static std::string getHostFeatureString() {
+    llvm::SubtargetFeatures features;
+    for (const auto& feature : llvm::sys::getHostCPUFeatures()) {
+        features.AddFeature(feature.first(), feature.second);
+    }
+    return features.getString();
+}
+
+CodeGenerator::CodeGenerator(std::ostream& errorOut)
+    : errorOut(errorOut),
+      context(std::make_unique<llvm::LLVMContext>()),
       module(nullptr),
       builder(std::make_unique<llvm::IRBuilder<>>(*context)),
+      optLevel(OptLevel::O0),
+      codegenThreads(1),
+      thinLTO(false),
+      objectCache(nullptr),
+      incrementalStore(nullptr),
       currentValue(nullptr),
       currentFunction(nullptr) {
-    // Initialize LLVM targets
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmParsers();
-    llvm::InitializeAllAsmPrinters();
+    initializeTargets();
+}
+
+void CodeGenerator::initializeTargets() {
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    });
+}
+
+bool CodeGenerator::initializeAllTargets() {
+#ifdef HASH_HOST_TARGET_ONLY
+    return false;
+#else
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmParsers();
+        llvm::InitializeAllAsmPrinters();
+    });
+    return true;
+#endif
+}
+
+bool CodeGenerator::isHostTarget() const {
+    return llvm::Triple::normalize(targetTriple) == llvm::Triple::normalize(llvm::sys::getDefaultTargetTriple());
 }
 
 CodeGenerator::~CodeGenerator() = default;
@@ -34,60 +130,666 @@ CodeGenerator::~CodeGenerator() = default;
 bool CodeGenerator::generate(Program& program, const std::string& moduleName) {
     module = std::make_unique<llvm::Module>(moduleName, *context);
     
-    // Set target triple - LLVM 21 requires llvm::Triple object
-    module->setTargetTriple(llvm::Triple(llvm::sys::getDefaultTargetTriple()));
+    // The optimizer needs the target's triple and data layout before any pass runs
+    if (!createTargetMachine()) {
+        return false;
+    }
+    module->setTargetTriple(targetMachine->getTargetTriple());
+    module->setDataLayout(targetMachine->createDataLayout());
     
+    identifiers = program.identifiers;
     program.accept(*this);
     
+    if (!linkRuntime()) {
+        return false;
+    }
+    
     // Verify the module
     std::string errorStr;
     llvm::raw_string_ostream errorStream(errorStr);
     if (llvm::verifyModule(*module, &errorStream)) {
-        std::cerr << "Module verification failed:\n" << errorStr << std::endl;
+        errorOut << "Module verification failed:\n" << errorStr << std::endl;
         return false;
     }
     
+    // Run the middle-end so both object files and --emit-llvm see optimized IR.
+    // Incremental builds optimize each function's module separately instead.
+    // ThinLTO modules only get the pre-link part here; the rest runs in thinLink.
+    if (!incrementalStore) {
+        optimize(*module);
+    }
+    
     return true;
 }
 
-void CodeGenerator::emitObjectFile(const std::string& filename) {
-    auto targetTriple = llvm::sys::getDefaultTargetTriple();
+bool CodeGenerator::createTargetMachine() {
+    if (targetMachine) {
+        return true;
+    }
     
+    if (targetTriple.empty()) {
+        targetTriple = llvm::sys::getDefaultTargetTriple();
+    }
+    
+    // Only the host backend is registered up front; a cross target pulls
+    // in the rest
     std::string error;
     auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    if (!target && !isHostTarget() && initializeAllTargets()) {
+        target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    }
     
     if (!target) {
-        std::cerr << "Failed to lookup target: " << error << std::endl;
-        return;
+        errorOut << "Failed to lookup target: " << error << std::endl;
+#ifdef HASH_HOST_TARGET_ONLY
+        errorOut << "This hashc was built with only the host backend (HASH_HOST_TARGET_ONLY)" << std::endl;
+#endif
+        return false;
     }
     
-    auto CPU = "generic";
-    auto features = "";
+    // Resolve the CPU once so the target machine and the per-function
+    // attributes always agree
+    if (targetCPU.empty()) {
+        targetCPU = optLevel == OptLevel::O0 || !isHostTarget() ? "generic" : "native";
+    }
+    if (targetCPU == "native" && !isHostTarget()) {
+        errorOut << "--target-cpu=native cannot be used when compiling for " << targetTriple << std::endl;
+        return false;
+    }
+    if (targetCPU == "native") {
+        targetCPU = llvm::sys::getHostCPUName().str();
+        std::string hostFeatures = getHostFeatureString();
+        if (!targetFeatures.empty() && !hostFeatures.empty()) {
+            hostFeatures += ",";
+        }
+        targetFeatures = hostFeatures + targetFeatures;
+    }
+    
+    targetMachine = newTargetMachine();
+    return true;
+}
+
+std::string CodeGenerator::describeTarget() {
+    if (!createTargetMachine()) {
+        return "";
+    }
+    return targetMachine->getTargetTriple().str() + " " + targetCPU + " " + targetFeatures;
+}
+
+std::unique_ptr<llvm::TargetMachine> CodeGenerator::newTargetMachine() const {
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
     
     llvm::TargetOptions opt;
     std::optional<llvm::Reloc::Model> RM;
-    auto targetMachine = target->createTargetMachine(targetTriple, CPU, features, opt, RM);
+    std::unique_ptr<llvm::TargetMachine> machine(
+        target->createTargetMachine(targetTriple, targetCPU, targetFeatures, opt, RM));
+    
+    // Match the backend's effort to the requested optimization level
+    switch (optLevel) {
+        case OptLevel::O0: machine->setOptLevel(llvm::CodeGenOptLevel::None); break;
+        case OptLevel::O1: machine->setOptLevel(llvm::CodeGenOptLevel::Less); break;
+        case OptLevel::O3: machine->setOptLevel(llvm::CodeGenOptLevel::Aggressive); break;
+        default: machine->setOptLevel(llvm::CodeGenOptLevel::Default); break;
+    }
     
-    module->setDataLayout(targetMachine->createDataLayout());
+    return machine;
+}
+
+void CodeGenerator::optimize(llvm::Module& target) {
+    // Same setup clang uses: the default new-pass-manager pipelines, with the
+    // vectorizers enabled from -O2 upward (and for -Os, but not -Oz)
+    llvm::PipelineTuningOptions tuning;
+    tuning.LoopVectorization = optLevel == OptLevel::O2 || optLevel == OptLevel::O3 || optLevel == OptLevel::Os;
+    tuning.SLPVectorization = tuning.LoopVectorization;
+    tuning.LoopUnrolling = optLevel != OptLevel::Os && optLevel != OptLevel::Oz;
+    
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+    
+    // Instrumentation is added to (or the profile read into) the IR before
+    // the rest of the pipeline, as clang does for -fprofile-generate/-use
+    std::optional<llvm::PGOOptions> pgo;
+    if (!profileGenerate.empty()) {
+        pgo = llvm::PGOOptions(profileGenerate, "", "", "", llvm::vfs::getRealFileSystem(),
+                               llvm::PGOOptions::IRInstr);
+    } else if (!profileUse.empty()) {
+        pgo = llvm::PGOOptions(profileUse, "", "", "", llvm::vfs::getRealFileSystem(),
+                               llvm::PGOOptions::IRUse);
+    }
+    
+    llvm::PassBuilder passBuilder(targetMachine.get(), tuning, pgo);
+    passBuilder.registerModuleAnalyses(MAM);
+    passBuilder.registerCGSCCAnalyses(CGAM);
+    passBuilder.registerFunctionAnalyses(FAM);
+    passBuilder.registerLoopAnalyses(LAM);
+    passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+    
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O2;
+    switch (optLevel) {
+        case OptLevel::O0: level = llvm::OptimizationLevel::O0; break;
+        case OptLevel::O1: level = llvm::OptimizationLevel::O1; break;
+        case OptLevel::O2: level = llvm::OptimizationLevel::O2; break;
+        case OptLevel::O3: level = llvm::OptimizationLevel::O3; break;
+        case OptLevel::Os: level = llvm::OptimizationLevel::Os; break;
+        case OptLevel::Oz: level = llvm::OptimizationLevel::Oz; break;
+    }
+    
+    // ThinLTO modules stop before the passes that need the whole program;
+    // thinLink runs those once functions have been imported across modules
+    llvm::ModulePassManager MPM;
+    if (optLevel == OptLevel::O0) {
+        MPM = passBuilder.buildO0DefaultPipeline(level, thinLTO ? llvm::ThinOrFullLTOPhase::ThinLTOPreLink
+                                                                : llvm::ThinOrFullLTOPhase::None);
+    } else if (thinLTO) {
+        MPM = passBuilder.buildThinLTOPreLinkDefaultPipeline(level);
+    } else {
+        MPM = passBuilder.buildPerModuleDefaultPipeline(level);
+    }
+    
+    MPM.run(target, MAM);
+}
+
+bool CodeGenerator::linkRuntime() {
+#ifdef HASH_HAVE_RUNTIME_BITCODE
+    bool usesRuntime = false;
+    for (const llvm::Function& func : *module) {
+        if (func.isDeclaration() && func.getName().starts_with("hashrt_")) {
+            usesRuntime = true;
+            break;
+        }
+    }
+    if (!usesRuntime) {
+        return true;
+    }
+    
+    llvm::StringRef bitcode(reinterpret_cast<const char*>(hashrtBitcode), hashrtBitcodeSize);
+    auto runtime = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "hashrt.bc"), *context);
+    if (!runtime) {
+        errorOut << "Failed to load runtime bitcode: " << llvm::toString(runtime.takeError()) << std::endl;
+        return false;
+    }
+    
+    // The bitcode is built for the host. When cross-compiling, leave the
+    // calls external for a libhashrt built for the target to resolve.
+    const llvm::Triple& runtimeTriple = (*runtime)->getTargetTriple();
+    const llvm::Triple& moduleTriple = module->getTargetTriple();
+    if (runtimeTriple.getArch() != moduleTriple.getArch() || runtimeTriple.getOS() != moduleTriple.getOS()) {
+        return true;
+    }
+    (*runtime)->setTargetTriple(moduleTriple);
+    (*runtime)->setDataLayout(module->getDataLayout());
+    
+    // Compile the runtime for the program's CPU so its loops vectorize with
+    // the same features, and so it can inline into the program's functions
+    for (llvm::Function& func : **runtime) {
+        if (func.isDeclaration()) {
+            continue;
+        }
+        func.addFnAttr("target-cpu", targetCPU);
+        if (targetFeatures.empty()) {
+            func.removeFnAttr("target-features");
+        } else {
+            func.addFnAttr("target-features", targetFeatures);
+        }
+    }
+    
+    if (llvm::Linker::linkModules(*module, std::move(*runtime), llvm::Linker::Flags::LinkOnlyNeeded)) {
+        errorOut << "Failed to link runtime bitcode" << std::endl;
+        return false;
+    }
+    
+    // The linked definitions belong to this module alone, which lets the
+    // optimizer inline them and drop whatever is left unused
+    for (llvm::Function& func : *module) {
+        if (!func.isDeclaration() && func.getName().starts_with("hashrt_")) {
+            func.setLinkage(llvm::Function::InternalLinkage);
+        }
+    }
+#endif
+    return true;
+}
+
+void CodeGenerator::emitObjectFile(const std::string& filename) {
+    llvm::SmallVector<char, 0> buffer;
+    if (!emitObject(buffer)) {
+        return;
+    }
     
     std::error_code EC;
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        std::cerr << "Could not open file: " << EC.message() << std::endl;
+        errorOut << "Could not open file: " << EC.message() << std::endl;
         return;
     }
     
+    dest.write(buffer.data(), buffer.size());
+    dest.flush();
+}
+
+bool CodeGenerator::emitObject(llvm::SmallVectorImpl<char>& buffer) {
+    if (!createTargetMachine()) {
+        return false;
+    }
+    return emitModuleObject(*module, *targetMachine, buffer);
+}
+
+bool CodeGenerator::emitModuleObject(llvm::Module& target, llvm::TargetMachine& machine,
+                                     llvm::SmallVectorImpl<char>& buffer) {
+    llvm::raw_svector_ostream dest(buffer);
+    
     llvm::legacy::PassManager pass;
     auto fileType = llvm::CodeGenFileType::ObjectFile;
     
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
-        std::cerr << "TargetMachine can't emit a file of this type" << std::endl;
-        return;
+    if (machine.addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+        errorOut << "TargetMachine can't emit a file of this type" << std::endl;
+        return false;
     }
     
-    pass.run(*module);
-    dest.flush();
+    pass.run(target);
+    return true;
+}
+
+bool CodeGenerator::emitObjects(std::vector<llvm::SmallVector<char, 0>>& objects) {
+    if (!createTargetMachine()) {
+        return false;
+    }
+    
+    unsigned threads = codegenThreads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    unsigned definedFunctions = 0;
+    for (const llvm::Function& func : *module) {
+        if (!func.isDeclaration()) {
+            definedFunctions++;
+        }
+    }
+    threads = std::min(threads, std::max(1u, definedFunctions));
+    
+    objects.clear();
+    if (threads == 1) {
+        objects.emplace_back();
+        return emitObject(objects.back());
+    }
+    
+    // The module has already been through the whole-module optimizer, so
+    // inlining has happened and only the backend is left. SplitModule turns
+    // internal symbols into hidden external ones so calls across partitions
+    // still resolve at link time.
+    std::vector<llvm::SmallString<0>> partitions;
+    llvm::SplitModule(*module, threads, [&](std::unique_ptr<llvm::Module> partition) {
+        partitions.emplace_back();
+        llvm::raw_svector_ostream stream(partitions.back());
+        llvm::WriteBitcodeToFile(*partition, stream);
+    });
+    
+    // An LLVMContext can only be used from one thread at a time, so each
+    // partition travels as bitcode and is read back into its own context
+    objects.resize(partitions.size());
+    std::vector<std::string> errors(partitions.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        workers.emplace_back([this, &partitions, &objects, &errors, i]() {
+            llvm::LLVMContext partitionContext;
+            auto partition = llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(partitions[i], "partition"), partitionContext);
+            if (!partition) {
+                errors[i] = llvm::toString(partition.takeError());
+                return;
+            }
+            
+            std::unique_ptr<llvm::TargetMachine> machine = newTargetMachine();
+            if (!emitModuleObject(**partition, *machine, objects[i])) {
+                errors[i] = "object emission failed";
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            errorOut << "Parallel code generation failed: " << error << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CodeGenerator::emitThinLTOBitcode(llvm::SmallVectorImpl<char>& buffer) {
+    // The summary lists each function's calls and size, which is what the
+    // thin link uses to decide what to import into other modules
+    llvm::ProfileSummaryInfo profileSummary(*module);
+    llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(*module, nullptr, &profileSummary);
+    
+    // The module hash keeps the names of locals promoted during importing,
+    // e.g. builtins every module has a copy of, unique across modules
+    llvm::raw_svector_ostream stream(buffer);
+    llvm::WriteBitcodeToFile(*module, stream, false, &index, true);
+    return true;
+}
+
+bool CodeGenerator::thinLink(const std::vector<llvm::SmallVector<char, 0>>& modules,
+                             std::vector<llvm::SmallVector<char, 0>>& objects) {
+    if (!createTargetMachine()) {
+        return false;
+    }
+    
+    llvm::lto::Config config;
+    config.CPU = targetCPU;
+    config.MAttrs = llvm::SubtargetFeatures(targetFeatures).getFeatures();
+    config.CGOptLevel = targetMachine->getOptLevel();
+    switch (optLevel) {
+        case OptLevel::O0: config.OptLevel = 0; break;
+        case OptLevel::O1: config.OptLevel = 1; break;
+        case OptLevel::O3: config.OptLevel = 3; break;
+        default: config.OptLevel = 2; break;
+    }
+    
+    // Backends run on the codegen threads; 0 uses every core
+    llvm::lto::ThinBackend backend = llvm::lto::createInProcessThinBackend(
+        llvm::heavyweight_hardware_concurrency(codegenThreads));
+    llvm::lto::LTO lto(std::move(config), backend);
+    
+    // Module identifiers key the combined index, so they must be unique and
+    // outlive the link
+    std::vector<std::string> names;
+    for (size_t i = 0; i < modules.size(); i++) {
+        names.push_back("module" + std::to_string(i));
+    }
+    
+    std::unordered_set<std::string> defined;
+    for (size_t i = 0; i < modules.size(); i++) {
+        llvm::MemoryBufferRef buffer(llvm::StringRef(modules[i].data(), modules[i].size()), names[i]);
+        auto input = llvm::lto::InputFile::create(buffer);
+        if (!input) {
+            errorOut << "Failed to read module for ThinLTO: " << llvm::toString(input.takeError()) << std::endl;
+            return false;
+        }
+        
+        // The whole program is here, so only main is reachable from outside
+        // and every other definition may be internalized after importing.
+        // Weak definitions, e.g. from profile instrumentation, can repeat
+        // across modules; the first one wins.
+        std::vector<llvm::lto::SymbolResolution> resolutions;
+        for (const llvm::lto::InputFile::Symbol& symbol : (*input)->symbols()) {
+            llvm::lto::SymbolResolution resolution;
+            std::string name = symbol.getName().str();
+            resolution.Prevailing = !symbol.isUndefined() && defined.insert(name).second;
+            resolution.FinalDefinitionInLinkageUnit = !symbol.isUndefined();
+            resolution.VisibleToRegularObj = name == "main" || name.rfind("__llvm_profile", 0) == 0;
+            resolutions.push_back(resolution);
+        }
+        
+        if (llvm::Error error = lto.add(std::move(*input), resolutions)) {
+            errorOut << "ThinLTO failed: " << llvm::toString(std::move(error)) << std::endl;
+            return false;
+        }
+    }
+    
+    // Each backend task streams its object into its own slot
+    objects.clear();
+    objects.resize(lto.getMaxTasks());
+    auto addStream = [&objects](unsigned task, const llvm::Twine&)
+        -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+        return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+    };
+    if (llvm::Error error = lto.run(addStream)) {
+        errorOut << "ThinLTO failed: " << llvm::toString(std::move(error)) << std::endl;
+        return false;
+    }
+    
+    // The regular LTO task has nothing to do when every module is thin
+    objects.erase(std::remove_if(objects.begin(), objects.end(),
+                                 [](const llvm::SmallVector<char, 0>& object) { return object.empty(); }),
+                  objects.end());
+    return true;
+}
+
+bool CodeGenerator::linkModules(const std::vector<llvm::SmallVector<char, 0>>& modules) {
+    for (const auto& bitcode : modules) {
+        auto imported = llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), "module"), *context);
+        if (!imported) {
+            errorOut << "Failed to load module: " << llvm::toString(imported.takeError()) << std::endl;
+            return false;
+        }
+        if (llvm::Linker::linkModules(*module, std::move(*imported))) {
+            errorOut << "Failed to link module" << std::endl;
+            return false;
+        }
+    }
+    
+    // Every module has only been through the pre-link pipeline; finish the
+    // job on the combined module so calls across modules inline
+    thinLTO = false;
+    optimize(*module);
+    return true;
+}
+
+// Drops internal functions and constants nothing refers to, e.g. the
+// builtins of other functions left behind by CloneModule
+static void removeUnusedLocals(llvm::Module& target) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (llvm::GlobalValue& value : llvm::make_early_inc_range(target.global_values())) {
+            value.removeDeadConstantUsers();
+            if (value.hasLocalLinkage() && value.use_empty()) {
+                value.eraseFromParent();
+                changed = true;
+            }
+        }
+    }
+}
+
+bool CodeGenerator::emitIncrementalObjects(std::vector<llvm::SmallVector<char, 0>>& objects) {
+    if (!incrementalStore || !createTargetMachine()) {
+        return false;
+    }
+    
+    objects.clear();
+    for (llvm::Function& func : *module) {
+        if (func.hasLocalLinkage()) {
+            continue;
+        }
+        if (func.isDeclaration()) {
+            // Either a builtin/libc declaration, or a function visit(FunctionDecl&)
+            // skipped because its stored object is still valid
+            if (functions.count(func.getName().str())) {
+                auto stored = incrementalStore->load(func.getName().str());
+                if (!stored) {
+                    errorOut << "Stored object for '" << func.getName().str() << "' disappeared" << std::endl;
+                    return false;
+                }
+                objects.emplace_back(stored->getBufferStart(), stored->getBufferEnd());
+            }
+            continue;
+        }
+        
+        // This function, plus private copies of the builtins, runtime and
+        // string constants it uses. Other functions and globals stay external.
+        llvm::ValueToValueMapTy valueMap;
+        std::unique_ptr<llvm::Module> functionModule = llvm::CloneModule(*module, valueMap,
+            [&func](const llvm::GlobalValue* value) {
+                return value == &func || value->hasLocalLinkage();
+            });
+        removeUnusedLocals(*functionModule);
+        optimize(*functionModule);
+        
+        objects.emplace_back();
+        if (!emitModuleObject(*functionModule, *targetMachine, objects.back())) {
+            return false;
+        }
+        incrementalStore->store(func.getName().str(), objects.back());
+    }
+    
+    // Globals are cheap to emit, so their definitions are rebuilt every time
+    bool hasGlobals = llvm::any_of(module->globals(), [](const llvm::GlobalVariable& global) {
+        return !global.hasLocalLinkage();
+    });
+    if (hasGlobals) {
+        llvm::ValueToValueMapTy valueMap;
+        std::unique_ptr<llvm::Module> globalsModule = llvm::CloneModule(*module, valueMap,
+            [](const llvm::GlobalValue* value) {
+                return llvm::isa<llvm::GlobalVariable>(value);
+            });
+        removeUnusedLocals(*globalsModule);
+        objects.emplace_back();
+        if (!emitModuleObject(*globalsModule, *targetMachine, objects.back())) {
+            return false;
+        }
+    }
+    
+    incrementalStore->prune();
+    return true;
+}
+
+llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> CodeGenerator::createJIT() {
+    if (!createTargetMachine()) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(), "no target machine");
+    }
+    if (!isHostTarget()) {
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "cannot run code compiled for " + targetTriple + " on this machine");
+    }
+    
+    // JIT for the same CPU and features the module was optimized for
+    llvm::orc::JITTargetMachineBuilder machineBuilder(targetMachine->getTargetTriple());
+    machineBuilder.setCPU(targetCPU);
+    machineBuilder.addFeatures(llvm::SubtargetFeatures(targetFeatures).getFeatures());
+    machineBuilder.setCodeGenOptLevel(targetMachine->getOptLevel());
+    
+    llvm::orc::LLJITBuilder jitBuilder;
+    jitBuilder.setJITTargetMachineBuilder(std::move(machineBuilder));
+    if (objectCache) {
+        // Compile through the cache so the object can be reused by later runs
+        llvm::ObjectCache* cache = objectCache;
+        jitBuilder.setCompileFunctionCreator(
+            [cache](llvm::orc::JITTargetMachineBuilder builder)
+                -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+                return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(builder), cache);
+            });
+    }
+    auto jit = jitBuilder.create();
+    if (!jit) {
+        return jit.takeError();
+    }
+    
+    // Resolve printf, malloc, fopen, ... from the libc already loaded into hashc
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        return processSymbols.takeError();
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*processSymbols));
+    
+    // Runtime calls that were not linked from bitcode bind to the copy of
+    // libhashrt inside hashc itself
+    llvm::orc::SymbolMap runtimeSymbols;
+    auto addRuntimeSymbol = [&](const char* name, auto* address) {
+        runtimeSymbols[(*jit)->mangleAndIntern(name)] = llvm::orc::ExecutorSymbolDef(
+            llvm::orc::ExecutorAddr::fromPtr(address), llvm::JITSymbolFlags::Exported);
+    };
+    addRuntimeSymbol("hashrt_len", &hashrt_len);
+    addRuntimeSymbol("hashrt_str_concat", &hashrt_str_concat);
+    addRuntimeSymbol("hashrt_str_eq", &hashrt_str_eq);
+    addRuntimeSymbol("hashrt_upper", &hashrt_upper);
+    addRuntimeSymbol("hashrt_lower", &hashrt_lower);
+    addRuntimeSymbol("hashrt_file_read", &hashrt_file_read);
+    addRuntimeSymbol("hashrt_file_write", &hashrt_file_write);
+    addRuntimeSymbol("hashrt_file_exists", &hashrt_file_exists);
+    addRuntimeSymbol("hashrt_file_delete", &hashrt_file_delete);
+    addRuntimeSymbol("hashrt_time", &hashrt_time);
+    addRuntimeSymbol("hashrt_clock", &hashrt_clock);
+    addRuntimeSymbol("hashrt_random", &hashrt_random);
+    addRuntimeSymbol("hashrt_seed_random", &hashrt_seed_random);
+    addRuntimeSymbol("hashrt_random_range", &hashrt_random_range);
+    if (auto err = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(runtimeSymbols)))) {
+        return std::move(err);
+    }
+    
+    return jit;
+}
+
+bool CodeGenerator::runJIT(int& exitCode) {
+    llvm::Function* mainFunc = module->getFunction("main");
+    if (!mainFunc || mainFunc->isDeclaration()) {
+        errorOut << "No 'main' function to run" << std::endl;
+        return false;
+    }
+    if (mainFunc->arg_size() != 0) {
+        errorOut << "'main' cannot be run because it takes parameters" << std::endl;
+        return false;
+    }
+    
+    // Enter through an int-returning wrapper whatever main's return type is,
+    // so a cached object can be run without knowing it. Integers become the
+    // exit code; any other result exits with 0.
+    llvm::Function* entry = llvm::Function::Create(
+        llvm::FunctionType::get(builder->getInt32Ty(), false),
+        llvm::Function::ExternalLinkage, jitEntryName, module.get());
+    builder->SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", entry));
+    llvm::Value* result = builder->CreateCall(mainFunc);
+    llvm::Type* returnType = mainFunc->getReturnType();
+    if (returnType->isIntegerTy()) {
+        // bool is i1, which exits with 1 for true rather than -1
+        bool isSigned = !returnType->isIntegerTy(1);
+        builder->CreateRet(builder->CreateIntCast(result, builder->getInt32Ty(), isSigned));
+    } else {
+        builder->CreateRet(builder->getInt32(0));
+    }
+    
+    auto jit = createJIT();
+    if (!jit) {
+        errorOut << "Failed to create JIT: " << llvm::toString(jit.takeError()) << std::endl;
+        return false;
+    }
+    
+    // The JIT takes ownership of the module and its context
+    builder.reset();
+    module->setDataLayout((*jit)->getDataLayout());
+    llvm::orc::ThreadSafeModule threadSafeModule(std::move(module), std::move(context));
+    if (auto err = (*jit)->addIRModule(std::move(threadSafeModule))) {
+        errorOut << "Failed to add module to JIT: " << llvm::toString(std::move(err)) << std::endl;
+        return false;
+    }
+    
+    return runJITEntry(**jit, exitCode);
+}
+
+bool CodeGenerator::runJITObject(std::unique_ptr<llvm::MemoryBuffer> object, int& exitCode) {
+    auto jit = createJIT();
+    if (!jit) {
+        errorOut << "Failed to create JIT: " << llvm::toString(jit.takeError()) << std::endl;
+        return false;
+    }
+    
+    if (auto err = (*jit)->addObjectFile(std::move(object))) {
+        errorOut << "Failed to add object to JIT: " << llvm::toString(std::move(err)) << std::endl;
+        return false;
+    }
+    
+    return runJITEntry(**jit, exitCode);
+}
+
+bool CodeGenerator::runJITEntry(llvm::orc::LLJIT& jit, int& exitCode) {
+    auto entrySymbol = jit.lookup(jitEntryName);
+    if (!entrySymbol) {
+        errorOut << "Failed to look up 'main': " << llvm::toString(entrySymbol.takeError()) << std::endl;
+        return false;
+    }
+    
+    exitCode = entrySymbol->toPtr<int (*)()>()();
+    
+    // The program wrote through hashc's own stdio buffers
+    std::fflush(stdout);
+    return true;
 }
 
 void CodeGenerator::emitLLVMIR(const std::string& filename) {
@@ -95,7 +797,7 @@ void CodeGenerator::emitLLVMIR(const std::string& filename) {
     llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
     
     if (EC) {
-        std::cerr << "Could not open file: " << EC.message() << std::endl;
+        errorOut << "Could not open file: " << EC.message() << std::endl;
         return;
     }
     
@@ -103,23 +805,30 @@ void CodeGenerator::emitLLVMIR(const std::string& filename) {
     dest.flush();
 }
 
-llvm::Type* CodeGenerator::getLLVMType(const std::shared_ptr<Type>& type) {
+llvm::Type* CodeGenerator::getLLVMType(const Type* type) {
+    // Types are unique, so the mapping is cached per type object
+    llvm::Type*& cached = llvmTypes[type];
+    if (cached) {
+        return cached;
+    }
+    
     switch (type->kind) {
-        case Type::Kind::I8: return llvm::Type::getInt8Ty(*context);
-        case Type::Kind::I16: return llvm::Type::getInt16Ty(*context);
-        case Type::Kind::I32: return llvm::Type::getInt32Ty(*context);
-        case Type::Kind::I64: return llvm::Type::getInt64Ty(*context);
-        case Type::Kind::U8: return llvm::Type::getInt8Ty(*context);
-        case Type::Kind::U16: return llvm::Type::getInt16Ty(*context);
-        case Type::Kind::U32: return llvm::Type::getInt32Ty(*context);
-        case Type::Kind::U64: return llvm::Type::getInt64Ty(*context);
-        case Type::Kind::F32: return llvm::Type::getFloatTy(*context);
-        case Type::Kind::F64: return llvm::Type::getDoubleTy(*context);
-        case Type::Kind::BOOL: return llvm::Type::getInt1Ty(*context);
-        case Type::Kind::VOID: return llvm::Type::getVoidTy(*context);
-        case Type::Kind::STR: return llvm::PointerType::get(*context, 0);
-        default: return llvm::Type::getInt32Ty(*context);
+        case Type::Kind::I8: cached = llvm::Type::getInt8Ty(*context); break;
+        case Type::Kind::I16: cached = llvm::Type::getInt16Ty(*context); break;
+        case Type::Kind::I32: cached = llvm::Type::getInt32Ty(*context); break;
+        case Type::Kind::I64: cached = llvm::Type::getInt64Ty(*context); break;
+        case Type::Kind::U8: cached = llvm::Type::getInt8Ty(*context); break;
+        case Type::Kind::U16: cached = llvm::Type::getInt16Ty(*context); break;
+        case Type::Kind::U32: cached = llvm::Type::getInt32Ty(*context); break;
+        case Type::Kind::U64: cached = llvm::Type::getInt64Ty(*context); break;
+        case Type::Kind::F32: cached = llvm::Type::getFloatTy(*context); break;
+        case Type::Kind::F64: cached = llvm::Type::getDoubleTy(*context); break;
+        case Type::Kind::BOOL: cached = llvm::Type::getInt1Ty(*context); break;
+        case Type::Kind::VOID: cached = llvm::Type::getVoidTy(*context); break;
+        case Type::Kind::STR: cached = llvm::PointerType::get(*context, 0); break;
+        default: cached = llvm::Type::getInt32Ty(*context); break;
     }
+    return cached;
 }
 
 llvm::AllocaInst* CodeGenerator::createEntryBlockAlloca(llvm::Function* function, 
@@ -129,861 +838,310 @@ llvm::AllocaInst* CodeGenerator::createEntryBlockAlloca(llvm::Function* function
     return tmpBuilder.CreateAlloca(type, nullptr, varName);
 }
 
+llvm::Function* CodeGenerator::getLibcFunction(const std::string& name) {
+    if (llvm::Function* existing = module->getFunction(name)) {
+        return existing;
+    }
+    
+    llvm::Type* voidTy = llvm::Type::getVoidTy(*context);
+    llvm::Type* i32Ty = llvm::Type::getInt32Ty(*context);
+    llvm::Type* ptrTy = llvm::PointerType::get(*context, 0);
+    
+    llvm::FunctionType* type = nullptr;
+    if (name == "printf" || name == "scanf") {
+        type = llvm::FunctionType::get(i32Ty, {ptrTy}, true);
+    } else if (name == "exit") {
+        type = llvm::FunctionType::get(voidTy, {i32Ty}, false);
+    } else if (name == "asin" || name == "acos" || name == "atan") {
+        llvm::Type* f64Ty = llvm::Type::getDoubleTy(*context);
+        type = llvm::FunctionType::get(f64Ty, {f64Ty}, false);
+    } else {
+        return nullptr;
+    }
+    
+    return llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, module.get());
+}
+
+llvm::Function* CodeGenerator::getOrCreateBuiltin(Builtin builtin) {
+    llvm::Function*& cached = builtinFunctions[static_cast<size_t>(builtin)];
+    if (!cached) {
+        cached = emitBuiltin(builtin);
+    }
+    return cached;
+}
+
+llvm::Function* CodeGenerator::emitBuiltin(Builtin builtin) {
+    std::string name = getBuiltinName(builtin);
+    // Builtins live under a mangled name that cannot clash with libc (abs,
+    // sqrt, random, ...) or with a user function of the same name
+    std::string symbol = "hash.builtin." + name;
+    
+    // Builtins are built in the middle of a caller's body
+    llvm::IRBuilderBase::InsertPointGuard guard(*builder);
+    
+    llvm::Type* voidTy = llvm::Type::getVoidTy(*context);
+    llvm::Type* i1Ty = llvm::Type::getInt1Ty(*context);
+    llvm::Type* i32Ty = llvm::Type::getInt32Ty(*context);
+    llvm::Type* i64Ty = llvm::Type::getInt64Ty(*context);
+    llvm::Type* f64Ty = llvm::Type::getDoubleTy(*context);
+    llvm::Type* ptrTy = llvm::PointerType::get(*context, 0);
+    
+    auto createBuiltin = [&](llvm::Type* returnType, llvm::ArrayRef<llvm::Type*> params) {
+        llvm::FunctionType* type = llvm::FunctionType::get(returnType, params, false);
+        llvm::Function* func = llvm::Function::Create(
+            type, llvm::Function::InternalLinkage, symbol, module.get());
+        func->setDoesNotThrow();
+        llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", func);
+        builder->SetInsertPoint(entry);
+        return func;
+    };
+    
+    // Pure arithmetic builtins: always inlined (even at -O0) so a call to
+    // min/max/abs costs no more than the instructions it expands to
+    auto createInlineBuiltin = [&](llvm::Type* returnType, llvm::ArrayRef<llvm::Type*> params) {
+        llvm::Function* func = createBuiltin(returnType, params);
+        func->addFnAttr(llvm::Attribute::AlwaysInline);
+        func->setDoesNotAccessMemory();
+        func->setWillReturn();
+        return func;
+    };
+    
+    // Strings, files, time and random numbers are implemented in C++ in
+    // libhashrt (runtime/hashrt.cpp). Only the declaration is emitted
+    // here; linkRuntime() brings in the definition.
+    auto declareRuntime = [&](llvm::Type* returnType, llvm::ArrayRef<llvm::Type*> params) {
+        // hash_time/hash_clock already carry a prefix in the language
+        std::string runtimeName = "hashrt_" + (name.compare(0, 5, "hash_") == 0 ? name.substr(5) : name);
+        llvm::FunctionType* type = llvm::FunctionType::get(returnType, params, false);
+        llvm::Function* func = llvm::Function::Create(
+            type, llvm::Function::ExternalLinkage, runtimeName, module.get());
+        if (returnType == i1Ty) {
+            func->addRetAttr(llvm::Attribute::ZExt);
+        }
+        return func;
+    };
+    
+    switch (builtin) {
+        // ========================================
+        // Console output
+        // ========================================
+        
+        case Builtin::PrintI32:
+        case Builtin::Print:
+        case Builtin::PrintI64:
+        case Builtin::PrintF64:
+        case Builtin::PrintStr: {
+            llvm::Type* argType = i32Ty;
+            const char* format = "%d\n";
+            if (builtin == Builtin::PrintI64) {
+                argType = i64Ty;
+                format = "%lld\n";
+            } else if (builtin == Builtin::PrintF64) {
+                argType = f64Ty;
+                format = "%f\n";
+            } else if (builtin == Builtin::PrintStr) {
+                argType = ptrTy;
+                format = "%s\n";
+            }
+            
+            llvm::Function* func = createBuiltin(voidTy, {argType});
+            llvm::Value* formatStr = builder->CreateGlobalStringPtr(format);
+            builder->CreateCall(getLibcFunction("printf"), {formatStr, func->getArg(0)});
+            builder->CreateRetVoid();
+            return func;
+        }
+        
+        case Builtin::PrintBool: {
+            llvm::Function* func = createBuiltin(voidTy, {i1Ty});
+            llvm::Value* trueStr = builder->CreateGlobalStringPtr("true\n");
+            llvm::Value* falseStr = builder->CreateGlobalStringPtr("false\n");
+            llvm::Value* selectedStr = builder->CreateSelect(func->getArg(0), trueStr, falseStr);
+            builder->CreateCall(getLibcFunction("printf"), {selectedStr});
+            builder->CreateRetVoid();
+            return func;
+        }
+        
+        // println (just prints newline)
+        case Builtin::Println: {
+            llvm::Function* func = createBuiltin(voidTy, {});
+            llvm::Value* newlineStr = builder->CreateGlobalStringPtr("\n");
+            builder->CreateCall(getLibcFunction("printf"), {newlineStr});
+            builder->CreateRetVoid();
+            return func;
+        }
+        
+        // ========================================
+        // Type conversions
+        // ========================================
+        
+        // i32_to_i64: sign extension
+        case Builtin::I32ToI64: {
+            llvm::Function* func = createInlineBuiltin(i64Ty, {i32Ty});
+            builder->CreateRet(builder->CreateSExt(func->getArg(0), i64Ty));
+            return func;
+        }
+        
+        // i64_to_i32: truncation
+        case Builtin::I64ToI32: {
+            llvm::Function* func = createInlineBuiltin(i32Ty, {i64Ty});
+            builder->CreateRet(builder->CreateTrunc(func->getArg(0), i32Ty));
+            return func;
+        }
+        
+        // i32_to_f64 and float(i32)
+        case Builtin::I32ToF64:
+        case Builtin::Float: {
+            llvm::Function* func = createInlineBuiltin(f64Ty, {i32Ty});
+            builder->CreateRet(builder->CreateSIToFP(func->getArg(0), f64Ty));
+            return func;
+        }
+        
+        // f64_to_i32 and int(f64)
+        case Builtin::F64ToI32:
+        case Builtin::Int: {
+            llvm::Function* func = createInlineBuiltin(i32Ty, {f64Ty});
+            builder->CreateRet(builder->CreateFPToSI(func->getArg(0), i32Ty));
+            return func;
+        }
+        
+        case Builtin::I64ToF64: {
+            llvm::Function* func = createInlineBuiltin(f64Ty, {i64Ty});
+            builder->CreateRet(builder->CreateSIToFP(func->getArg(0), f64Ty));
+            return func;
+        }
+        
+        case Builtin::F64ToI64: {
+            llvm::Function* func = createInlineBuiltin(i64Ty, {f64Ty});
+            builder->CreateRet(builder->CreateFPToSI(func->getArg(0), i64Ty));
+            return func;
+        }
+        
+        // ========================================
+        // Math
+        // ========================================
+        
+        // abs_i32 / abs: if value < 0, return -value, else return value
+        case Builtin::AbsI32:
+        case Builtin::Abs: {
+            llvm::Function* func = createInlineBuiltin(i32Ty, {i32Ty});
+            llvm::Value* input = func->getArg(0);
+            llvm::Value* isNeg = builder->CreateICmpSLT(input, llvm::ConstantInt::get(i32Ty, 0));
+            llvm::Value* negated = builder->CreateNeg(input);
+            builder->CreateRet(builder->CreateSelect(isNeg, negated, input));
+            return func;
+        }
+        
+        case Builtin::MinI32:
+        case Builtin::Min: {
+            llvm::Function* func = createInlineBuiltin(i32Ty, {i32Ty, i32Ty});
+            llvm::Value* a = func->getArg(0);
+            llvm::Value* b = func->getArg(1);
+            builder->CreateRet(builder->CreateSelect(builder->CreateICmpSLT(a, b), a, b));
+            return func;
+        }
+        
+        case Builtin::MaxI32:
+        case Builtin::Max: {
+            llvm::Function* func = createInlineBuiltin(i32Ty, {i32Ty, i32Ty});
+            llvm::Value* a = func->getArg(0);
+            llvm::Value* b = func->getArg(1);
+            builder->CreateRet(builder->CreateSelect(builder->CreateICmpSGT(a, b), a, b));
+            return func;
+        }
+        
+        // sqrt_f64 via LLVM's sqrt intrinsic (sqrt itself is lowered in visit(CallExpr&))
+        case Builtin::SqrtF64:
+        case Builtin::Sqrt: {
+            llvm::Function* func = createInlineBuiltin(f64Ty, {f64Ty});
+            llvm::Function* sqrtIntrinsic = llvm::Intrinsic::getDeclaration(
+                module.get(), llvm::Intrinsic::sqrt, {f64Ty});
+            builder->CreateRet(builder->CreateCall(sqrtIntrinsic, {func->getArg(0)}));
+            return func;
+        }
+        
+        // ========================================
+        // Input (scanf)
+        // ========================================
+        
+        case Builtin::ReadI32:
+        case Builtin::ReadF64: {
+            bool isFloat = builtin == Builtin::ReadF64;
+            llvm::Type* valueType = isFloat ? f64Ty : i32Ty;
+            llvm::Function* func = createBuiltin(valueType, {});
+            llvm::Value* format = builder->CreateGlobalStringPtr(isFloat ? "%lf" : "%d");
+            llvm::AllocaInst* inputPtr = builder->CreateAlloca(valueType);
+            builder->CreateCall(getLibcFunction("scanf"), {format, inputPtr});
+            builder->CreateRet(builder->CreateLoad(valueType, inputPtr));
+            return func;
+        }
+        
+        // ========================================
+        // System
+        // ========================================
+        
+        case Builtin::Exit:
+        case Builtin::Asin:
+        case Builtin::Acos:
+        case Builtin::Atan:
+            return getLibcFunction(name);
+        
+        // ========================================
+        // Runtime library
+        // ========================================
+        
+        case Builtin::Len:
+            return declareRuntime(i32Ty, {ptrTy});
+        case Builtin::StrConcat:
+            return declareRuntime(ptrTy, {ptrTy, ptrTy});
+        case Builtin::StrEq:
+        case Builtin::FileWrite:
+            return declareRuntime(i1Ty, {ptrTy, ptrTy});
+        case Builtin::Upper:
+        case Builtin::Lower:
+        case Builtin::FileRead:
+            return declareRuntime(ptrTy, {ptrTy});
+        case Builtin::FileExists:
+        case Builtin::FileDelete:
+            return declareRuntime(i1Ty, {ptrTy});
+        case Builtin::HashTime:
+            return declareRuntime(i64Ty, {});
+        case Builtin::HashClock:
+        case Builtin::Random:
+            return declareRuntime(f64Ty, {});
+        case Builtin::SeedRandom:
+            return declareRuntime(voidTy, {i32Ty});
+        case Builtin::RandomRange:
+            return declareRuntime(i32Ty, {i32Ty, i32Ty});
+        
+        // The remaining math functions are intrinsics, see emitMathBuiltin
+        default:
+            return nullptr;
+    }
+}
+
 void CodeGenerator::visit(Program& node) {
-    // Declare external functions (printf for basic I/O)
-    std::vector<llvm::Type*> printfArgs = {llvm::PointerType::get(*context, 0)};
-    llvm::FunctionType* printfType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context), printfArgs, true);
-    llvm::Function::Create(printfType, llvm::Function::ExternalLinkage, "printf", module.get());
-    
-    // Declare built-in print_i32 function
-    std::vector<llvm::Type*> printI32Args = {llvm::Type::getInt32Ty(*context)};
-    llvm::FunctionType* printI32Type = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), printI32Args, false);
-    llvm::Function* printI32Func = llvm::Function::Create(
-        printI32Type, llvm::Function::ExternalLinkage, "print_i32", module.get());
-    
-    // Implement print_i32 using printf
-    llvm::BasicBlock* printBlock = llvm::BasicBlock::Create(*context, "entry", printI32Func);
-    builder->SetInsertPoint(printBlock);
-    
-    // Create format string "%d\n"
-    llvm::Value* formatStr = builder->CreateGlobalStringPtr("%d\n");
-    
-    // Get the parameter
-    llvm::Value* value = printI32Func->getArg(0);
-    
-    // Call printf
-    llvm::Function* printfFunc = module->getFunction("printf");
-    builder->CreateCall(printfFunc, {formatStr, value});
-    builder->CreateRetVoid();
-    
-    // Declare and implement print_i64
-    std::vector<llvm::Type*> printI64Args = {llvm::Type::getInt64Ty(*context)};
-    llvm::FunctionType* printI64Type = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), printI64Args, false);
-    llvm::Function* printI64Func = llvm::Function::Create(
-        printI64Type, llvm::Function::ExternalLinkage, "print_i64", module.get());
-    
-    llvm::BasicBlock* printI64Block = llvm::BasicBlock::Create(*context, "entry", printI64Func);
-    builder->SetInsertPoint(printI64Block);
-    llvm::Value* formatI64Str = builder->CreateGlobalStringPtr("%lld\n");
-    llvm::Value* i64Value = printI64Func->getArg(0);
-    builder->CreateCall(printfFunc, {formatI64Str, i64Value});
-    builder->CreateRetVoid();
-    
-    // Declare and implement print_f64
-    std::vector<llvm::Type*> printF64Args = {llvm::Type::getDoubleTy(*context)};
-    llvm::FunctionType* printF64Type = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), printF64Args, false);
-    llvm::Function* printF64Func = llvm::Function::Create(
-        printF64Type, llvm::Function::ExternalLinkage, "print_f64", module.get());
-    
-    llvm::BasicBlock* printF64Block = llvm::BasicBlock::Create(*context, "entry", printF64Func);
-    builder->SetInsertPoint(printF64Block);
-    llvm::Value* formatF64Str = builder->CreateGlobalStringPtr("%f\n");
-    llvm::Value* f64Value = printF64Func->getArg(0);
-    builder->CreateCall(printfFunc, {formatF64Str, f64Value});
-    builder->CreateRetVoid();
-    
-    // Declare and implement print_bool
-    std::vector<llvm::Type*> printBoolArgs = {llvm::Type::getInt1Ty(*context)};
-    llvm::FunctionType* printBoolType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), printBoolArgs, false);
-    llvm::Function* printBoolFunc = llvm::Function::Create(
-        printBoolType, llvm::Function::ExternalLinkage, "print_bool", module.get());
-    
-    llvm::BasicBlock* printBoolBlock = llvm::BasicBlock::Create(*context, "entry", printBoolFunc);
-    builder->SetInsertPoint(printBoolBlock);
-    llvm::Value* boolValue = printBoolFunc->getArg(0);
-    
-    // Convert bool to i32 (0 or 1) and then select string
-    llvm::Value* boolAsInt = builder->CreateZExt(boolValue, llvm::Type::getInt32Ty(*context));
-    llvm::Value* trueStr = builder->CreateGlobalStringPtr("true\n");
-    llvm::Value* falseStr = builder->CreateGlobalStringPtr("false\n");
-    llvm::Value* selectedStr = builder->CreateSelect(boolValue, trueStr, falseStr);
-    builder->CreateCall(printfFunc, {selectedStr});
-    builder->CreateRetVoid();
-    
-    // Declare and implement print_str
-    std::vector<llvm::Type*> printStrArgs = {llvm::PointerType::get(*context, 0)};
-    llvm::FunctionType* printStrType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), printStrArgs, false);
-    llvm::Function* printStrFunc = llvm::Function::Create(
-        printStrType, llvm::Function::ExternalLinkage, "print_str", module.get());
-    
-    llvm::BasicBlock* printStrBlock = llvm::BasicBlock::Create(*context, "entry", printStrFunc);
-    builder->SetInsertPoint(printStrBlock);
-    llvm::Value* formatStrStr = builder->CreateGlobalStringPtr("%s\n");
-    llvm::Value* strValue = printStrFunc->getArg(0);
-    builder->CreateCall(printfFunc, {formatStrStr, strValue});
-    builder->CreateRetVoid();
-    
-    // Declare and implement println (just prints newline)
-    llvm::FunctionType* printlnType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), {}, false);
-    llvm::Function* printlnFunc = llvm::Function::Create(
-        printlnType, llvm::Function::ExternalLinkage, "println", module.get());
-    
-    llvm::BasicBlock* printlnBlock = llvm::BasicBlock::Create(*context, "entry", printlnFunc);
-    builder->SetInsertPoint(printlnBlock);
-    llvm::Value* newlineStr = builder->CreateGlobalStringPtr("\n");
-    builder->CreateCall(printfFunc, {newlineStr});
-    builder->CreateRetVoid();
-    
-    // Type conversion built-ins
-    
-    // i32_to_i64: convert i32 to i64 (sign extension)
-    llvm::FunctionType* i32ToI64Type = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* i32ToI64Func = llvm::Function::Create(
-        i32ToI64Type, llvm::Function::ExternalLinkage, "i32_to_i64", module.get());
-    llvm::BasicBlock* i32ToI64Block = llvm::BasicBlock::Create(*context, "entry", i32ToI64Func);
-    builder->SetInsertPoint(i32ToI64Block);
-    llvm::Value* i32Val = i32ToI64Func->getArg(0);
-    llvm::Value* i64Val = builder->CreateSExt(i32Val, llvm::Type::getInt64Ty(*context));
-    builder->CreateRet(i64Val);
-    
-    // i64_to_i32: convert i64 to i32 (truncation)
-    llvm::FunctionType* i64ToI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt64Ty(*context)},
-        false);
-    llvm::Function* i64ToI32Func = llvm::Function::Create(
-        i64ToI32Type, llvm::Function::ExternalLinkage, "i64_to_i32", module.get());
-    llvm::BasicBlock* i64ToI32Block = llvm::BasicBlock::Create(*context, "entry", i64ToI32Func);
-    builder->SetInsertPoint(i64ToI32Block);
-    llvm::Value* i64Input = i64ToI32Func->getArg(0);
-    llvm::Value* i32Result = builder->CreateTrunc(i64Input, llvm::Type::getInt32Ty(*context));
-    builder->CreateRet(i32Result);
-    
-    // i32_to_f64: convert i32 to f64
-    llvm::FunctionType* i32ToF64Type = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* i32ToF64Func = llvm::Function::Create(
-        i32ToF64Type, llvm::Function::ExternalLinkage, "i32_to_f64", module.get());
-    llvm::BasicBlock* i32ToF64Block = llvm::BasicBlock::Create(*context, "entry", i32ToF64Func);
-    builder->SetInsertPoint(i32ToF64Block);
-    llvm::Value* i32ForFloat = i32ToF64Func->getArg(0);
-    llvm::Value* f64Result = builder->CreateSIToFP(i32ForFloat, llvm::Type::getDoubleTy(*context));
-    builder->CreateRet(f64Result);
-    
-    // f64_to_i32: convert f64 to i32
-    llvm::FunctionType* f64ToI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getDoubleTy(*context)},
-        false);
-    llvm::Function* f64ToI32Func = llvm::Function::Create(
-        f64ToI32Type, llvm::Function::ExternalLinkage, "f64_to_i32", module.get());
-    llvm::BasicBlock* f64ToI32Block = llvm::BasicBlock::Create(*context, "entry", f64ToI32Func);
-    builder->SetInsertPoint(f64ToI32Block);
-    llvm::Value* f64Input = f64ToI32Func->getArg(0);
-    llvm::Value* i32FromFloat = builder->CreateFPToSI(f64Input, llvm::Type::getInt32Ty(*context));
-    builder->CreateRet(i32FromFloat);
-    
-    // i64_to_f64: convert i64 to f64
-    llvm::FunctionType* i64ToF64Type = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context),
-        {llvm::Type::getInt64Ty(*context)},
-        false);
-    llvm::Function* i64ToF64Func = llvm::Function::Create(
-        i64ToF64Type, llvm::Function::ExternalLinkage, "i64_to_f64", module.get());
-    llvm::BasicBlock* i64ToF64Block = llvm::BasicBlock::Create(*context, "entry", i64ToF64Func);
-    builder->SetInsertPoint(i64ToF64Block);
-    llvm::Value* i64ForFloat = i64ToF64Func->getArg(0);
-    llvm::Value* f64FromI64 = builder->CreateSIToFP(i64ForFloat, llvm::Type::getDoubleTy(*context));
-    builder->CreateRet(f64FromI64);
-    
-    // f64_to_i64: convert f64 to i64
-    llvm::FunctionType* f64ToI64Type = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::Type::getDoubleTy(*context)},
-        false);
-    llvm::Function* f64ToI64Func = llvm::Function::Create(
-        f64ToI64Type, llvm::Function::ExternalLinkage, "f64_to_i64", module.get());
-    llvm::BasicBlock* f64ToI64Block = llvm::BasicBlock::Create(*context, "entry", f64ToI64Func);
-    builder->SetInsertPoint(f64ToI64Block);
-    llvm::Value* f64ForI64 = f64ToI64Func->getArg(0);
-    llvm::Value* i64FromFloat = builder->CreateFPToSI(f64ForI64, llvm::Type::getInt64Ty(*context));
-    builder->CreateRet(i64FromFloat);
-    
-    // Math built-ins
-    
-    // abs_i32: absolute value for i32
-    llvm::FunctionType* absI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* absI32Func = llvm::Function::Create(
-        absI32Type, llvm::Function::ExternalLinkage, "abs_i32", module.get());
-    llvm::BasicBlock* absI32Block = llvm::BasicBlock::Create(*context, "entry", absI32Func);
-    builder->SetInsertPoint(absI32Block);
-    llvm::Value* absInput = absI32Func->getArg(0);
-    // If value < 0, return -value, else return value
-    llvm::Value* isNeg = builder->CreateICmpSLT(absInput, llvm::ConstantInt::get(*context, llvm::APInt(32, 0)));
-    llvm::Value* negated = builder->CreateNeg(absInput);
-    llvm::Value* absResult = builder->CreateSelect(isNeg, negated, absInput);
-    builder->CreateRet(absResult);
-    
-    // min_i32: minimum of two i32 values
-    llvm::FunctionType* minI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* minI32Func = llvm::Function::Create(
-        minI32Type, llvm::Function::ExternalLinkage, "min_i32", module.get());
-    llvm::BasicBlock* minI32Block = llvm::BasicBlock::Create(*context, "entry", minI32Func);
-    builder->SetInsertPoint(minI32Block);
-    llvm::Value* minA = minI32Func->getArg(0);
-    llvm::Value* minB = minI32Func->getArg(1);
-    llvm::Value* isLess = builder->CreateICmpSLT(minA, minB);
-    llvm::Value* minResult = builder->CreateSelect(isLess, minA, minB);
-    builder->CreateRet(minResult);
-    
-    // max_i32: maximum of two i32 values
-    llvm::FunctionType* maxI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* maxI32Func = llvm::Function::Create(
-        maxI32Type, llvm::Function::ExternalLinkage, "max_i32", module.get());
-    llvm::BasicBlock* maxI32Block = llvm::BasicBlock::Create(*context, "entry", maxI32Func);
-    builder->SetInsertPoint(maxI32Block);
-    llvm::Value* maxA = maxI32Func->getArg(0);
-    llvm::Value* maxB = maxI32Func->getArg(1);
-    llvm::Value* isGreater = builder->CreateICmpSGT(maxA, maxB);
-    llvm::Value* maxResult = builder->CreateSelect(isGreater, maxA, maxB);
-    builder->CreateRet(maxResult);
-    
-    // sqrt_f64: square root for f64
-    llvm::FunctionType* sqrtF64Type = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context),
-        {llvm::Type::getDoubleTy(*context)},
-        false);
-    llvm::Function* sqrtF64Func = llvm::Function::Create(
-        sqrtF64Type, llvm::Function::ExternalLinkage, "sqrt_f64", module.get());
-    llvm::BasicBlock* sqrtF64Block = llvm::BasicBlock::Create(*context, "entry", sqrtF64Func);
-    builder->SetInsertPoint(sqrtF64Block);
-    llvm::Value* sqrtInput = sqrtF64Func->getArg(0);
-    // Use LLVM's intrinsic sqrt function
-    llvm::Function* sqrtIntrinsic = llvm::Intrinsic::getDeclaration(
-        module.get(), llvm::Intrinsic::sqrt, {llvm::Type::getDoubleTy(*context)});
-    llvm::Value* sqrtResult = builder->CreateCall(sqrtIntrinsic, {sqrtInput});
-    builder->CreateRet(sqrtResult);
-    
-    // ========================================
-    // Python-like aliases for better UX
-    // ========================================
-    
-    // int(f64) -> i32 (wrapper for f64_to_i32)
-    llvm::FunctionType* intType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getDoubleTy(*context)},
-        false);
-    llvm::Function* intFunc = llvm::Function::Create(
-        intType, llvm::Function::ExternalLinkage, "int", module.get());
-    llvm::BasicBlock* intBlock = llvm::BasicBlock::Create(*context, "entry", intFunc);
-    builder->SetInsertPoint(intBlock);
-    llvm::Value* intInput = intFunc->getArg(0);
-    llvm::Value* intResult = builder->CreateFPToSI(intInput, llvm::Type::getInt32Ty(*context));
-    builder->CreateRet(intResult);
-    
-    // float(i32) -> f64 (wrapper for i32_to_f64)
-    llvm::FunctionType* floatType = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* floatFunc = llvm::Function::Create(
-        floatType, llvm::Function::ExternalLinkage, "float", module.get());
-    llvm::BasicBlock* floatBlock = llvm::BasicBlock::Create(*context, "entry", floatFunc);
-    builder->SetInsertPoint(floatBlock);
-    llvm::Value* floatInput = floatFunc->getArg(0);
-    llvm::Value* floatResult = builder->CreateSIToFP(floatInput, llvm::Type::getDoubleTy(*context));
-    builder->CreateRet(floatResult);
-    
-    // abs(i32) -> i32 (wrapper for abs_i32)
-    llvm::FunctionType* absType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* absFunc = llvm::Function::Create(
-        absType, llvm::Function::ExternalLinkage, "abs", module.get());
-    llvm::BasicBlock* absBlock = llvm::BasicBlock::Create(*context, "entry", absFunc);
-    builder->SetInsertPoint(absBlock);
-    llvm::Value* absIn = absFunc->getArg(0);
-    llvm::Value* absIsNeg = builder->CreateICmpSLT(absIn, llvm::ConstantInt::get(*context, llvm::APInt(32, 0)));
-    llvm::Value* absNeg = builder->CreateNeg(absIn);
-    llvm::Value* absRes = builder->CreateSelect(absIsNeg, absNeg, absIn);
-    builder->CreateRet(absRes);
-    
-    // min(i32, i32) -> i32
-    llvm::FunctionType* minType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* minFunc = llvm::Function::Create(
-        minType, llvm::Function::ExternalLinkage, "min", module.get());
-    llvm::BasicBlock* minBlock = llvm::BasicBlock::Create(*context, "entry", minFunc);
-    builder->SetInsertPoint(minBlock);
-    llvm::Value* minArg1 = minFunc->getArg(0);
-    llvm::Value* minArg2 = minFunc->getArg(1);
-    llvm::Value* minLess = builder->CreateICmpSLT(minArg1, minArg2);
-    llvm::Value* minRes = builder->CreateSelect(minLess, minArg1, minArg2);
-    builder->CreateRet(minRes);
-    
-    // max(i32, i32) -> i32
-    llvm::FunctionType* maxType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function* maxFunc = llvm::Function::Create(
-        maxType, llvm::Function::ExternalLinkage, "max", module.get());
-    llvm::BasicBlock* maxBlock = llvm::BasicBlock::Create(*context, "entry", maxFunc);
-    builder->SetInsertPoint(maxBlock);
-    llvm::Value* maxArg1 = maxFunc->getArg(0);
-    llvm::Value* maxArg2 = maxFunc->getArg(1);
-    llvm::Value* maxGreater = builder->CreateICmpSGT(maxArg1, maxArg2);
-    llvm::Value* maxRes = builder->CreateSelect(maxGreater, maxArg1, maxArg2);
-    builder->CreateRet(maxRes);
-    
-    // sqrt(f64) -> f64
-    llvm::FunctionType* sqrtType = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context),
-        {llvm::Type::getDoubleTy(*context)},
-        false);
-    llvm::Function* sqrtWrapperFunc = llvm::Function::Create(
-        sqrtType, llvm::Function::ExternalLinkage, "sqrt", module.get());
-    llvm::BasicBlock* sqrtWrapperBlock = llvm::BasicBlock::Create(*context, "entry", sqrtWrapperFunc);
-    builder->SetInsertPoint(sqrtWrapperBlock);
-    llvm::Value* sqrtWrapperInput = sqrtWrapperFunc->getArg(0);
-    llvm::Function* sqrtWrapperIntrinsic = llvm::Intrinsic::getDeclaration(
-        module.get(), llvm::Intrinsic::sqrt, {llvm::Type::getDoubleTy(*context)});
-    llvm::Value* sqrtWrapperResult = builder->CreateCall(sqrtWrapperIntrinsic, {sqrtWrapperInput});
-    builder->CreateRet(sqrtWrapperResult);
-    
-    // ========================================
-    // Input Functions (using scanf)
-    // ========================================
-    
-    // Declare scanf for input
-    std::vector<llvm::Type*> scanfArgs = {llvm::PointerType::get(*context, 0)};
-    llvm::FunctionType* scanfType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context), scanfArgs, true);
-    llvm::Function* scanfFunc = llvm::Function::Create(
-        scanfType, llvm::Function::ExternalLinkage, "scanf", module.get());
-    
-    // read_i32() -> i32 (reads an integer from stdin)
-    llvm::FunctionType* readI32Type = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context), {}, false);
-    llvm::Function* readI32Func = llvm::Function::Create(
-        readI32Type, llvm::Function::ExternalLinkage, "read_i32", module.get());
-    llvm::BasicBlock* readI32Block = llvm::BasicBlock::Create(*context, "entry", readI32Func);
-    builder->SetInsertPoint(readI32Block);
-    llvm::Value* intFormatRead = builder->CreateGlobalStringPtr("%d");
-    llvm::AllocaInst* intInputPtr = builder->CreateAlloca(llvm::Type::getInt32Ty(*context));
-    builder->CreateCall(scanfFunc, {intFormatRead, intInputPtr});
-    llvm::Value* readIntValue = builder->CreateLoad(llvm::Type::getInt32Ty(*context), intInputPtr);
-    builder->CreateRet(readIntValue);
-    
-    // read_f64() -> f64 (reads a float from stdin)
-    llvm::FunctionType* readF64Type = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context), {}, false);
-    llvm::Function* readF64Func = llvm::Function::Create(
-        readF64Type, llvm::Function::ExternalLinkage, "read_f64", module.get());
-    llvm::BasicBlock* readF64Block = llvm::BasicBlock::Create(*context, "entry", readF64Func);
-    builder->SetInsertPoint(readF64Block);
-    llvm::Value* floatFormatRead = builder->CreateGlobalStringPtr("%lf");
-    llvm::AllocaInst* floatInputPtr = builder->CreateAlloca(llvm::Type::getDoubleTy(*context));
-    builder->CreateCall(scanfFunc, {floatFormatRead, floatInputPtr});
-    llvm::Value* readFloatValue = builder->CreateLoad(llvm::Type::getDoubleTy(*context), floatInputPtr);
-    builder->CreateRet(readFloatValue);
-    
-    // ========================================
-    // System Functions
-    // ========================================
-    
-    // Declare C library functions we'll use
-    llvm::FunctionType* cExitType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), {llvm::Type::getInt32Ty(*context)}, false);
-    llvm::Function::Create(cExitType, llvm::Function::ExternalLinkage, "exit", module.get());
-    
-    llvm::FunctionType* cTimeType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context), {llvm::PointerType::get(*context, 0)}, false);
-    llvm::Function::Create(cTimeType, llvm::Function::ExternalLinkage, "time", module.get());
-    
-    llvm::FunctionType* cClockType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context), {}, false);
-    llvm::Function::Create(cClockType, llvm::Function::ExternalLinkage, "clock", module.get());
-    
-    llvm::FunctionType* cRandType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context), {}, false);
-    llvm::Function::Create(cRandType, llvm::Function::ExternalLinkage, "rand", module.get());
-    
-    llvm::FunctionType* cSrandType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), {llvm::Type::getInt32Ty(*context)}, false);
-    llvm::Function::Create(cSrandType, llvm::Function::ExternalLinkage, "srand", module.get());
-    
-    // hash_time() -> i64 - Get current Unix timestamp
-    llvm::FunctionType* hashTimeType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context), {}, false);
-    llvm::Function* hashTimeFunc = llvm::Function::Create(
-        hashTimeType, llvm::Function::ExternalLinkage, "hash_time", module.get());
-    llvm::BasicBlock* timeBlock = llvm::BasicBlock::Create(*context, "entry", hashTimeFunc);
-    builder->SetInsertPoint(timeBlock);
-    llvm::Function* cTimeFunc = module->getFunction("time");
-    llvm::Value* nullPtr = llvm::ConstantPointerNull::get(llvm::PointerType::get(*context, 0));
-    llvm::Value* timestamp = builder->CreateCall(cTimeFunc, {nullPtr});
-    builder->CreateRet(timestamp);
-    
-    // hash_clock() -> f64 - Get program execution time in seconds
-    llvm::FunctionType* hashClockType = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context), {}, false);
-    llvm::Function* hashClockFunc = llvm::Function::Create(
-        hashClockType, llvm::Function::ExternalLinkage, "hash_clock", module.get());
-    llvm::BasicBlock* clockBlock = llvm::BasicBlock::Create(*context, "entry", hashClockFunc);
-    builder->SetInsertPoint(clockBlock);
-    llvm::Function* cClockFunc = module->getFunction("clock");
-    llvm::Value* clockTicks = builder->CreateCall(cClockFunc, {});
-    // Convert to seconds: clock_ticks / CLOCKS_PER_SEC
-    llvm::Value* clocksPerSec = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1000000);
-    llvm::Value* clockTicksF64 = builder->CreateSIToFP(clockTicks, llvm::Type::getDoubleTy(*context));
-    llvm::Value* clocksPerSecF64 = builder->CreateSIToFP(clocksPerSec, llvm::Type::getDoubleTy(*context));
-    llvm::Value* seconds = builder->CreateFDiv(clockTicksF64, clocksPerSecF64);
-    builder->CreateRet(seconds);
-    
-    // random() -> f64 - Random float between 0.0 and 1.0
-    llvm::FunctionType* randomType = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(*context), {}, false);
-    llvm::Function* randomFunc = llvm::Function::Create(
-        randomType, llvm::Function::ExternalLinkage, "random", module.get());
-    llvm::BasicBlock* randomBlock = llvm::BasicBlock::Create(*context, "entry", randomFunc);
-    builder->SetInsertPoint(randomBlock);
-    llvm::Function* cRandFunc = module->getFunction("rand");
-    llvm::Value* randValue = builder->CreateCall(cRandFunc, {});
-    // Convert to 0.0 - 1.0: rand() / RAND_MAX
-    llvm::Value* randMax = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 32767); // RAND_MAX
-    llvm::Value* randF64 = builder->CreateSIToFP(randValue, llvm::Type::getDoubleTy(*context));
-    llvm::Value* randMaxF64 = builder->CreateSIToFP(randMax, llvm::Type::getDoubleTy(*context));
-    llvm::Value* randomResult = builder->CreateFDiv(randF64, randMaxF64);
-    builder->CreateRet(randomResult);
-    
-    // seed_random(i32) -> void - Set random seed
-    std::vector<llvm::Type*> seedArgs = {llvm::Type::getInt32Ty(*context)};
-    llvm::FunctionType* seedType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(*context), seedArgs, false);
-    llvm::Function* seedFunc = llvm::Function::Create(
-        seedType, llvm::Function::ExternalLinkage, "seed_random", module.get());
-    llvm::BasicBlock* seedBlock = llvm::BasicBlock::Create(*context, "entry", seedFunc);
-    builder->SetInsertPoint(seedBlock);
-    llvm::Value* seed = seedFunc->getArg(0);
-    llvm::Function* cSrandFunc = module->getFunction("srand");
-    builder->CreateCall(cSrandFunc, {seed});
-    builder->CreateRetVoid();
-    
-    // random_range(i32, i32) -> i32 - Random integer in range [min, max]
-    std::vector<llvm::Type*> rangeArgs = {llvm::Type::getInt32Ty(*context), llvm::Type::getInt32Ty(*context)};
-    llvm::FunctionType* rangeType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context), rangeArgs, false);
-    llvm::Function* rangeFunc = llvm::Function::Create(
-        rangeType, llvm::Function::ExternalLinkage, "random_range", module.get());
-    llvm::BasicBlock* rangeBlock = llvm::BasicBlock::Create(*context, "entry", rangeFunc);
-    builder->SetInsertPoint(rangeBlock);
-    llvm::Value* minVal = rangeFunc->getArg(0);
-    llvm::Value* maxVal = rangeFunc->getArg(1);
-    llvm::Value* randVal = builder->CreateCall(cRandFunc, {});
-    // Calculate: min + (rand() % (max - min + 1))
-    llvm::Value* diff = builder->CreateSub(maxVal, minVal);
-    llvm::Value* diffPlusOne = builder->CreateAdd(diff, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 1));
-    llvm::Value* modulo = builder->CreateSRem(randVal, diffPlusOne);
-    llvm::Value* rangeResult = builder->CreateAdd(minVal, modulo);
-    builder->CreateRet(rangeResult);
-    
-    // ========================================
-    // String Manipulation Functions
-    // ========================================
-    
-    // Declare C library string functions
-    llvm::FunctionType* cStrlenType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cStrlenType, llvm::Function::ExternalLinkage, "strlen", module.get());
-    
-    llvm::FunctionType* cStrcmpType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cStrcmpType, llvm::Function::ExternalLinkage, "strcmp", module.get());
-    
-    llvm::FunctionType* cStrcatType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cStrcatType, llvm::Function::ExternalLinkage, "strcat", module.get());
-    
-    llvm::FunctionType* cStrcpyType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cStrcpyType, llvm::Function::ExternalLinkage, "strcpy", module.get());
-    
-    llvm::FunctionType* cMallocType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::Type::getInt64Ty(*context)},
-        false);
-    llvm::Function::Create(cMallocType, llvm::Function::ExternalLinkage, "malloc", module.get());
-    
-    llvm::FunctionType* cToupperType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function::Create(cToupperType, llvm::Function::ExternalLinkage, "toupper", module.get());
-    
-    llvm::FunctionType* cTolowerType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function::Create(cTolowerType, llvm::Function::ExternalLinkage, "tolower", module.get());
-    
-    // len(str) -> i32 - Python-style string length!
-    llvm::FunctionType* lenType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* lenFunc = llvm::Function::Create(
-        lenType, llvm::Function::ExternalLinkage, "len", module.get());
-    llvm::BasicBlock* lenBlock = llvm::BasicBlock::Create(*context, "entry", lenFunc);
-    builder->SetInsertPoint(lenBlock);
-    llvm::Value* strPtr = lenFunc->getArg(0);
-    llvm::Function* cStrlenFunc = module->getFunction("strlen");
-    llvm::Value* len64 = builder->CreateCall(cStrlenFunc, {strPtr});
-    llvm::Value* len32 = builder->CreateTrunc(len64, llvm::Type::getInt32Ty(*context));
-    builder->CreateRet(len32);
-    
-    // str_concat(str, str) -> str - Concatenate two strings
-    llvm::FunctionType* concatType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* concatFunc = llvm::Function::Create(
-        concatType, llvm::Function::ExternalLinkage, "str_concat", module.get());
-    llvm::BasicBlock* concatBlock = llvm::BasicBlock::Create(*context, "entry", concatFunc);
-    builder->SetInsertPoint(concatBlock);
-    llvm::Value* str1 = concatFunc->getArg(0);
-    llvm::Value* str2 = concatFunc->getArg(1);
-    // Calculate total length
-    llvm::Value* len1_64 = builder->CreateCall(cStrlenFunc, {str1});
-    llvm::Value* len2_64 = builder->CreateCall(cStrlenFunc, {str2});
-    llvm::Value* totalLen = builder->CreateAdd(len1_64, len2_64);
-    llvm::Value* allocSize = builder->CreateAdd(totalLen, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    // Allocate memory
-    llvm::Function* cMallocFunc = module->getFunction("malloc");
-    llvm::Value* resultPtr = builder->CreateCall(cMallocFunc, {allocSize});
-    // Copy strings
-    llvm::Function* cStrcpyFunc = module->getFunction("strcpy");
-    llvm::Function* cStrcatFunc = module->getFunction("strcat");
-    builder->CreateCall(cStrcpyFunc, {resultPtr, str1});
-    builder->CreateCall(cStrcatFunc, {resultPtr, str2});
-    builder->CreateRet(resultPtr);
-    
-    // str_eq(str, str) -> bool - String equality comparison
-    llvm::FunctionType* eqType = llvm::FunctionType::get(
-        llvm::Type::getInt1Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* eqFunc = llvm::Function::Create(
-        eqType, llvm::Function::ExternalLinkage, "str_eq", module.get());
-    llvm::BasicBlock* eqBlock = llvm::BasicBlock::Create(*context, "entry", eqFunc);
-    builder->SetInsertPoint(eqBlock);
-    llvm::Value* eqStr1 = eqFunc->getArg(0);
-    llvm::Value* eqStr2 = eqFunc->getArg(1);
-    llvm::Function* cStrcmpFunc = module->getFunction("strcmp");
-    llvm::Value* cmpResult = builder->CreateCall(cStrcmpFunc, {eqStr1, eqStr2});
-    llvm::Value* isEqual = builder->CreateICmpEQ(cmpResult, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0));
-    builder->CreateRet(isEqual);
-    
-    // upper(str) -> str - Convert to uppercase (Python-style!)
-    llvm::FunctionType* upperType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* upperFunc = llvm::Function::Create(
-        upperType, llvm::Function::ExternalLinkage, "upper", module.get());
-    llvm::BasicBlock* upperBlock = llvm::BasicBlock::Create(*context, "entry", upperFunc);
-    builder->SetInsertPoint(upperBlock);
-    llvm::Value* upperStr = upperFunc->getArg(0);
-    llvm::Value* upperLen64 = builder->CreateCall(cStrlenFunc, {upperStr});
-    llvm::Value* upperAllocSize = builder->CreateAdd(upperLen64, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    llvm::Value* upperResult = builder->CreateCall(cMallocFunc, {upperAllocSize});
-    // Copy and convert
-    llvm::Value* upperIdx = builder->CreateAlloca(llvm::Type::getInt64Ty(*context));
-    builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), upperIdx);
-    llvm::BasicBlock* upperLoopCond = llvm::BasicBlock::Create(*context, "loop.cond", upperFunc);
-    llvm::BasicBlock* upperLoopBody = llvm::BasicBlock::Create(*context, "loop.body", upperFunc);
-    llvm::BasicBlock* upperLoopEnd = llvm::BasicBlock::Create(*context, "loop.end", upperFunc);
-    builder->CreateBr(upperLoopCond);
-    // Loop condition
-    builder->SetInsertPoint(upperLoopCond);
-    llvm::Value* upperIdxVal = builder->CreateLoad(llvm::Type::getInt64Ty(*context), upperIdx);
-    llvm::Value* upperContinue = builder->CreateICmpULT(upperIdxVal, upperLen64);
-    builder->CreateCondBr(upperContinue, upperLoopBody, upperLoopEnd);
-    // Loop body
-    builder->SetInsertPoint(upperLoopBody);
-    llvm::Value* upperSrcPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), upperStr, upperIdxVal);
-    llvm::Value* upperChar = builder->CreateLoad(llvm::Type::getInt8Ty(*context), upperSrcPtr);
-    llvm::Value* upperCharExt = builder->CreateSExt(upperChar, llvm::Type::getInt32Ty(*context));
-    llvm::Function* cToupperFunc = module->getFunction("toupper");
-    llvm::Value* upperCharConv = builder->CreateCall(cToupperFunc, {upperCharExt});
-    llvm::Value* upperCharTrunc = builder->CreateTrunc(upperCharConv, llvm::Type::getInt8Ty(*context));
-    llvm::Value* upperDstPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), upperResult, upperIdxVal);
-    builder->CreateStore(upperCharTrunc, upperDstPtr);
-    llvm::Value* upperNextIdx = builder->CreateAdd(upperIdxVal, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    builder->CreateStore(upperNextIdx, upperIdx);
-    builder->CreateBr(upperLoopCond);
-    // Loop end - add null terminator
-    builder->SetInsertPoint(upperLoopEnd);
-    llvm::Value* upperNullPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), upperResult, upperLen64);
-    builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), upperNullPtr);
-    builder->CreateRet(upperResult);
-    
-    // lower(str) -> str - Convert to lowercase (Python-style!)
-    llvm::FunctionType* lowerType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* lowerFunc = llvm::Function::Create(
-        lowerType, llvm::Function::ExternalLinkage, "lower", module.get());
-    llvm::BasicBlock* lowerBlock = llvm::BasicBlock::Create(*context, "entry", lowerFunc);
-    builder->SetInsertPoint(lowerBlock);
-    llvm::Value* lowerStr = lowerFunc->getArg(0);
-    llvm::Value* lowerLen64 = builder->CreateCall(cStrlenFunc, {lowerStr});
-    llvm::Value* lowerAllocSize = builder->CreateAdd(lowerLen64, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    llvm::Value* lowerResult = builder->CreateCall(cMallocFunc, {lowerAllocSize});
-    // Copy and convert
-    llvm::Value* lowerIdx = builder->CreateAlloca(llvm::Type::getInt64Ty(*context));
-    builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), lowerIdx);
-    llvm::BasicBlock* lowerLoopCond = llvm::BasicBlock::Create(*context, "loop.cond", lowerFunc);
-    llvm::BasicBlock* lowerLoopBody = llvm::BasicBlock::Create(*context, "loop.body", lowerFunc);
-    llvm::BasicBlock* lowerLoopEnd = llvm::BasicBlock::Create(*context, "loop.end", lowerFunc);
-    builder->CreateBr(lowerLoopCond);
-    // Loop condition
-    builder->SetInsertPoint(lowerLoopCond);
-    llvm::Value* lowerIdxVal = builder->CreateLoad(llvm::Type::getInt64Ty(*context), lowerIdx);
-    llvm::Value* lowerContinue = builder->CreateICmpULT(lowerIdxVal, lowerLen64);
-    builder->CreateCondBr(lowerContinue, lowerLoopBody, lowerLoopEnd);
-    // Loop body
-    builder->SetInsertPoint(lowerLoopBody);
-    llvm::Value* lowerSrcPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), lowerStr, lowerIdxVal);
-    llvm::Value* lowerChar = builder->CreateLoad(llvm::Type::getInt8Ty(*context), lowerSrcPtr);
-    llvm::Value* lowerCharExt = builder->CreateSExt(lowerChar, llvm::Type::getInt32Ty(*context));
-    llvm::Function* cTolowerFunc = module->getFunction("tolower");
-    llvm::Value* lowerCharConv = builder->CreateCall(cTolowerFunc, {lowerCharExt});
-    llvm::Value* lowerCharTrunc = builder->CreateTrunc(lowerCharConv, llvm::Type::getInt8Ty(*context));
-    llvm::Value* lowerDstPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), lowerResult, lowerIdxVal);
-    builder->CreateStore(lowerCharTrunc, lowerDstPtr);
-    llvm::Value* lowerNextIdx = builder->CreateAdd(lowerIdxVal, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    builder->CreateStore(lowerNextIdx, lowerIdx);
-    builder->CreateBr(lowerLoopCond);
-    // Loop end - add null terminator
-    builder->SetInsertPoint(lowerLoopEnd);
-    llvm::Value* lowerNullPtr = builder->CreateGEP(llvm::Type::getInt8Ty(*context), lowerResult, lowerLen64);
-    builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), lowerNullPtr);
-    builder->CreateRet(lowerResult);
-    
-    // ========================================
-    // File I/O Functions
-    // ========================================
-    
-    // Declare C library file functions
-    llvm::FunctionType* cFopenType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cFopenType, llvm::Function::ExternalLinkage, "fopen", module.get());
-    
-    llvm::FunctionType* cFcloseType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cFcloseType, llvm::Function::ExternalLinkage, "fclose", module.get());
-    
-    llvm::FunctionType* cFseekType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::Type::getInt64Ty(*context), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function::Create(cFseekType, llvm::Function::ExternalLinkage, "fseek", module.get());
-    
-    llvm::FunctionType* cFtellType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cFtellType, llvm::Function::ExternalLinkage, "ftell", module.get());
-    
-    llvm::FunctionType* cFreadType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::Type::getInt64Ty(*context), 
-         llvm::Type::getInt64Ty(*context), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cFreadType, llvm::Function::ExternalLinkage, "fread", module.get());
-    
-    llvm::FunctionType* cFwriteType = llvm::FunctionType::get(
-        llvm::Type::getInt64Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::Type::getInt64Ty(*context),
-         llvm::Type::getInt64Ty(*context), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cFwriteType, llvm::Function::ExternalLinkage, "fwrite", module.get());
-    
-    llvm::FunctionType* cRemoveType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function::Create(cRemoveType, llvm::Function::ExternalLinkage, "remove", module.get());
-    
-    llvm::FunctionType* cAccessType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::Type::getInt32Ty(*context)},
-        false);
-    llvm::Function::Create(cAccessType, llvm::Function::ExternalLinkage, "_access", module.get());
-    
-    // file_read(str) -> str - Read entire file as string
-    llvm::FunctionType* fileReadType = llvm::FunctionType::get(
-        llvm::PointerType::get(*context, 0),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* fileReadFunc = llvm::Function::Create(
-        fileReadType, llvm::Function::ExternalLinkage, "file_read", module.get());
-    llvm::BasicBlock* fileReadBlock = llvm::BasicBlock::Create(*context, "entry", fileReadFunc);
-    builder->SetInsertPoint(fileReadBlock);
-    llvm::Value* filename = fileReadFunc->getArg(0);
-    
-    // Open file for reading
-    llvm::Value* modeR = builder->CreateGlobalStringPtr("rb");
-    llvm::Function* cFopenFunc = module->getFunction("fopen");
-    llvm::Value* filePtr = builder->CreateCall(cFopenFunc, {filename, modeR});
-    
-    // Check if file opened successfully
-    llvm::Value* fileIsNull = builder->CreateIsNull(filePtr);
-    llvm::BasicBlock* fileOpenedBlock = llvm::BasicBlock::Create(*context, "file.opened", fileReadFunc);
-    llvm::BasicBlock* fileFailBlock = llvm::BasicBlock::Create(*context, "file.fail", fileReadFunc);
-    builder->CreateCondBr(fileIsNull, fileFailBlock, fileOpenedBlock);
-    
-    // File failed to open - return empty string
-    builder->SetInsertPoint(fileFailBlock);
-    llvm::Value* emptyStr = builder->CreateGlobalStringPtr("");
-    builder->CreateRet(emptyStr);
-    
-    // File opened successfully
-    builder->SetInsertPoint(fileOpenedBlock);
-    
-    // Get file size
-    llvm::Function* cFseekFunc = module->getFunction("fseek");
-    llvm::Function* cFtellFunc = module->getFunction("ftell");
-    llvm::Value* seekEnd = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 2); // SEEK_END
-    llvm::Value* seekSet = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0); // SEEK_SET
-    builder->CreateCall(cFseekFunc, {filePtr, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), seekEnd});
-    llvm::Value* fileSize = builder->CreateCall(cFtellFunc, {filePtr});
-    builder->CreateCall(cFseekFunc, {filePtr, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 0), seekSet});
-    
-    // Allocate buffer
-    llvm::Value* bufferSize = builder->CreateAdd(fileSize, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1));
-    llvm::Value* buffer = builder->CreateCall(cMallocFunc, {bufferSize});
-    
-    // Read file
-    llvm::Function* cFreadFunc = module->getFunction("fread");
-    builder->CreateCall(cFreadFunc, {buffer, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1), fileSize, filePtr});
-    
-    // Null terminate
-    llvm::Value* nullPos = builder->CreateGEP(llvm::Type::getInt8Ty(*context), buffer, fileSize);
-    builder->CreateStore(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*context), 0), nullPos);
-    
-    // Close file
-    llvm::Function* cFcloseFunc = module->getFunction("fclose");
-    builder->CreateCall(cFcloseFunc, {filePtr});
-    
-    builder->CreateRet(buffer);
-    
-    // file_write(filename: str, content: str) -> bool - Write string to file
-    llvm::FunctionType* fileWriteType = llvm::FunctionType::get(
-        llvm::Type::getInt1Ty(*context),
-        {llvm::PointerType::get(*context, 0), llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* fileWriteFunc = llvm::Function::Create(
-        fileWriteType, llvm::Function::ExternalLinkage, "file_write", module.get());
-    llvm::BasicBlock* fileWriteBlock = llvm::BasicBlock::Create(*context, "entry", fileWriteFunc);
-    builder->SetInsertPoint(fileWriteBlock);
-    llvm::Value* writeFilename = fileWriteFunc->getArg(0);
-    llvm::Value* writeContent = fileWriteFunc->getArg(1);
-    
-    // Open file for writing
-    llvm::Value* modeW = builder->CreateGlobalStringPtr("wb");
-    llvm::Value* writeFilePtr = builder->CreateCall(cFopenFunc, {writeFilename, modeW});
-    
-    // Check if file opened
-    llvm::Value* writeFileIsNull = builder->CreateIsNull(writeFilePtr);
-    llvm::BasicBlock* writeOpenedBlock = llvm::BasicBlock::Create(*context, "write.opened", fileWriteFunc);
-    llvm::BasicBlock* writeFailBlock = llvm::BasicBlock::Create(*context, "write.fail", fileWriteFunc);
-    builder->CreateCondBr(writeFileIsNull, writeFailBlock, writeOpenedBlock);
-    
-    // Failed to open
-    builder->SetInsertPoint(writeFailBlock);
-    builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*context), 0)); // false
-    
-    // Opened successfully
-    builder->SetInsertPoint(writeOpenedBlock);
-    
-    // Get content length
-    llvm::Value* contentLen = builder->CreateCall(cStrlenFunc, {writeContent});
-    
-    // Write content
-    llvm::Function* cFwriteFunc = module->getFunction("fwrite");
-    builder->CreateCall(cFwriteFunc, {writeContent, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*context), 1), contentLen, writeFilePtr});
-    
-    // Close file
-    builder->CreateCall(cFcloseFunc, {writeFilePtr});
-    
-    builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*context), 1)); // true
-    
-    // file_exists(str) -> bool - Check if file exists
-    llvm::FunctionType* fileExistsType = llvm::FunctionType::get(
-        llvm::Type::getInt1Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* fileExistsFunc = llvm::Function::Create(
-        fileExistsType, llvm::Function::ExternalLinkage, "file_exists", module.get());
-    llvm::BasicBlock* fileExistsBlock = llvm::BasicBlock::Create(*context, "entry", fileExistsFunc);
-    builder->SetInsertPoint(fileExistsBlock);
-    llvm::Value* existsFilename = fileExistsFunc->getArg(0);
-    
-    // Use _access to check file existence (0 = F_OK on Windows)
-    llvm::Function* cAccessFunc = module->getFunction("_access");
-    llvm::Value* accessResult = builder->CreateCall(cAccessFunc, {existsFilename, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0)});
-    
-    // _access returns 0 if file exists, -1 if not
-    llvm::Value* fileExists = builder->CreateICmpEQ(accessResult, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0));
-    builder->CreateRet(fileExists);
-    
-    // file_delete(str) -> bool - Delete file
-    llvm::FunctionType* fileDeleteType = llvm::FunctionType::get(
-        llvm::Type::getInt1Ty(*context),
-        {llvm::PointerType::get(*context, 0)},
-        false);
-    llvm::Function* fileDeleteFunc = llvm::Function::Create(
-        fileDeleteType, llvm::Function::ExternalLinkage, "file_delete", module.get());
-    llvm::BasicBlock* fileDeleteBlock = llvm::BasicBlock::Create(*context, "entry", fileDeleteFunc);
-    builder->SetInsertPoint(fileDeleteBlock);
-    llvm::Value* deleteFilename = fileDeleteFunc->getArg(0);
-    
-    // Use remove() to delete file
-    llvm::Function* cRemoveFunc = module->getFunction("remove");
-    llvm::Value* removeResult = builder->CreateCall(cRemoveFunc, {deleteFilename});
-    
-    // remove() returns 0 on success, non-zero on failure
-    llvm::Value* deleteSuccess = builder->CreateICmpEQ(removeResult, llvm::ConstantInt::get(llvm::Type::getInt32Ty(*context), 0));
-    builder->CreateRet(deleteSuccess);
+    // Built-in functions are emitted on demand by visit(CallExpr&), so a
+    // module only contains the runtime pieces the program actually calls
+    
+    // Names were resolved by SemanticAnalyzer; these map its bindings to
+    // this module's values
+    globalVariables.assign(node.globals.size(), nullptr);
+    definedFunctions.clear();
+    importedDeclarations.clear();
+    builtinFunctions.assign(static_cast<size_t>(Builtin::Count), nullptr);
+    
+    // Imported functions are defined by other modules of the program. They
+    // stay out of `functions`, which only tracks this module's own.
+    for (const auto& info : importedFunctions) {
+        std::vector<llvm::Type*> paramTypes;
+        for (const auto& paramType : info.paramTypes) {
+            paramTypes.push_back(getLLVMType(paramType));
+        }
+        llvm::FunctionType* funcType = llvm::FunctionType::get(
+            getLLVMType(info.returnType), paramTypes, false);
+        importedDeclarations.push_back(
+            llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, info.name, module.get()));
+    }
     
     // Generate global variables
     for (auto& global : node.globals) {
@@ -1009,29 +1167,43 @@ void CodeGenerator::visit(FunctionDecl& node) {
     
     // Create function
     llvm::Function* function = llvm::Function::Create(
-        funcType, llvm::Function::ExternalLinkage, node.name, module.get());
+        funcType, llvm::Function::ExternalLinkage, getName(node.id), module.get());
+    
+    functions[getName(node.id)] = function;
+    definedFunctions.push_back(function);
+    
+    // Unchanged since the last incremental build: callers only need the
+    // declaration, and the stored object provides the code
+    if (incrementalStore && incrementalStore->has(getName(node.id))) {
+        return;
+    }
     
-    functions[node.name] = function;
     currentFunction = function;
     
+    function->addFnAttr("target-cpu", targetCPU);
+    if (!targetFeatures.empty()) {
+        function->addFnAttr("target-features", targetFeatures);
+    }
+    
     // Set parameter names
     unsigned idx = 0;
     for (auto& arg : function->args()) {
-        arg.setName(node.parameters[idx++].name);
+        arg.setName(getName(node.parameters[idx++].id));
     }
     
     // Create entry block
     llvm::BasicBlock* entryBlock = llvm::BasicBlock::Create(*context, "entry", function);
     builder->SetInsertPoint(entryBlock);
     
-    // Allocate space for parameters and store their values
-    namedValues.clear();
+    // Allocate space for parameters and store their values. Parameters
+    // take the first slots.
+    localSlots.assign(node.localCount, nullptr);
     idx = 0;
     for (auto& arg : function->args()) {
         llvm::AllocaInst* alloca = createEntryBlockAlloca(
-            function, arg.getName().str(), arg.getType());
+            function, getName(node.parameters[idx].id), arg.getType());
         builder->CreateStore(&arg, alloca);
-        namedValues[arg.getName().str()] = alloca;
+        localSlots[idx] = alloca;
         idx++;
     }
     
@@ -1051,7 +1223,7 @@ void CodeGenerator::visit(FunctionDecl& node) {
     std::string errorStr;
     llvm::raw_string_ostream errorStream(errorStr);
     if (llvm::verifyFunction(*function, &errorStream)) {
-        std::cerr << "Function verification failed for '" << node.name << "':\n" 
+        errorOut << "Function verification failed for '" << getName(node.id) << "':\n" 
                   << errorStr << std::endl;
     }
     
@@ -1063,18 +1235,18 @@ void CodeGenerator::visit(VariableDecl& node) {
     
     if (currentFunction) {
         // Local variable
-        llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction, node.name, type);
-        namedValues[node.name] = alloca;
+        llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction, getName(node.id), type);
+        localSlots[node.binding.index] = alloca;
         
         if (node.initializer) {
-            node.initializer->accept(*this);
+            walker.walk(*node.initializer, *this);
             builder->CreateStore(currentValue, alloca);
         }
     } else {
         // Global variable
         llvm::Constant* initializer = nullptr;
         if (node.initializer) {
-            node.initializer->accept(*this);
+            walker.walk(*node.initializer, *this);
             if (auto* constant = llvm::dyn_cast<llvm::Constant>(currentValue)) {
                 initializer = constant;
             } else {
@@ -1084,26 +1256,27 @@ void CodeGenerator::visit(VariableDecl& node) {
             initializer = llvm::Constant::getNullValue(type);
         }
         
-        module->getOrInsertGlobal(node.name, type);
-        llvm::GlobalVariable* gVar = module->getNamedGlobal(node.name);
+        module->getOrInsertGlobal(getName(node.id), type);
+        llvm::GlobalVariable* gVar = module->getNamedGlobal(getName(node.id));
         gVar->setInitializer(initializer);
+        globalVariables[node.binding.index] = gVar;
     }
 }
 
 void CodeGenerator::visit(Assignment& node) {
-    auto it = namedValues.find(node.name);
-    if (it == namedValues.end()) {
-        std::cerr << "Unknown variable name: " << node.name << std::endl;
+    llvm::Value* variable = getVariable(node.binding);
+    if (!variable) {
+        errorOut << "Unknown variable name: " << getName(node.id) << std::endl;
         return;
     }
     
-    node.value->accept(*this);
-    builder->CreateStore(currentValue, it->second);
+    walker.walk(*node.value, *this);
+    builder->CreateStore(currentValue, variable);
 }
 
 void CodeGenerator::visit(ReturnStmt& node) {
     if (node.value) {
-        node.value->accept(*this);
+        walker.walk(*node.value, *this);
         builder->CreateRet(currentValue);
     } else {
         builder->CreateRetVoid();
@@ -1111,7 +1284,7 @@ void CodeGenerator::visit(ReturnStmt& node) {
 }
 
 void CodeGenerator::visit(IfStmt& node) {
-    node.condition->accept(*this);
+    walker.walk(*node.condition, *this);
     llvm::Value* condValue = currentValue;
     
     llvm::Function* function = builder->GetInsertBlock()->getParent();
@@ -1169,7 +1342,7 @@ void CodeGenerator::visit(WhileStmt& node) {
     
     // Condition block
     builder->SetInsertPoint(condBlock);
-    node.condition->accept(*this);
+    walker.walk(*node.condition, *this);
     llvm::Value* condValue = currentValue;
     builder->CreateCondBr(condValue, bodyBlock, afterBlock);
     
@@ -1189,7 +1362,7 @@ void CodeGenerator::visit(WhileStmt& node) {
 }
 
 void CodeGenerator::visit(ExprStmt& node) {
-    node.expression->accept(*this);
+    walker.walk(*node.expression, *this);
 }
 
 void CodeGenerator::visit(IntegerLiteral& node) {
@@ -1232,28 +1405,39 @@ void CodeGenerator::visit(BoolLiteral& node) {
     currentValue = llvm::ConstantInt::get(*context, llvm::APInt(1, node.value ? 1 : 0));
 }
 
+llvm::Value* CodeGenerator::getVariable(const Binding& binding) const {
+    switch (binding.kind) {
+        case Binding::Kind::LOCAL:
+            return localSlots[binding.index];
+        case Binding::Kind::GLOBAL:
+            return globalVariables[binding.index];
+        default:
+            return nullptr;
+    }
+}
+
 void CodeGenerator::visit(Identifier& node) {
-    auto it = namedValues.find(node.name);
-    if (it == namedValues.end()) {
-        // Try global variable
-        llvm::GlobalVariable* gVar = module->getNamedGlobal(node.name);
-        if (gVar) {
-            currentValue = builder->CreateLoad(gVar->getValueType(), gVar, node.name);
-        } else {
-            std::cerr << "Unknown variable name: " << node.name << std::endl;
-            currentValue = nullptr;
-        }
+    llvm::Value* variable = getVariable(node.binding);
+    if (!variable) {
+        errorOut << "Unknown variable name: " << getName(node.id) << std::endl;
+        currentValue = nullptr;
         return;
     }
     
-    currentValue = builder->CreateLoad(it->second->getAllocatedType(), it->second, node.name);
+    llvm::Type* type = getLLVMType(node.type);
+    currentValue = builder->CreateLoad(type, variable, getName(node.id));
 }
 
 void CodeGenerator::visit(BinaryOp& node) {
-    node.left->accept(*this);
-    llvm::Value* left = currentValue;
-    
-    node.right->accept(*this);
+    switch (walker.stage()) {
+        case 0:
+            return walker.descend(*node.left);
+        case 1:
+            operandValues.push_back(currentValue);
+            return walker.descend(*node.right);
+    }
+    llvm::Value* left = operandValues.back();
+    operandValues.pop_back();
     llvm::Value* right = currentValue;
     
     if (!left || !right) {
@@ -1333,7 +1517,9 @@ void CodeGenerator::visit(BinaryOp& node) {
 }
 
 void CodeGenerator::visit(UnaryOp& node) {
-    node.operand->accept(*this);
+    if (walker.stage() == 0) {
+        return walker.descend(*node.operand);
+    }
     llvm::Value* operand = currentValue;
     
     if (!operand) {
@@ -1358,110 +1544,97 @@ void CodeGenerator::visit(UnaryOp& node) {
     }
 }
 
+void CodeGenerator::emitMathBuiltin(Builtin builtin, llvm::ArrayRef<llvm::Value*> args) {
+    llvm::Intrinsic::ID intrinsicID = llvm::Intrinsic::not_intrinsic;
+    switch (builtin) {
+        case Builtin::Pow: intrinsicID = llvm::Intrinsic::pow; break;
+        case Builtin::Floor: intrinsicID = llvm::Intrinsic::floor; break;
+        case Builtin::Ceil: intrinsicID = llvm::Intrinsic::ceil; break;
+        case Builtin::Round: intrinsicID = llvm::Intrinsic::round; break;
+        case Builtin::Sqrt: intrinsicID = llvm::Intrinsic::sqrt; break;
+        case Builtin::Sin: intrinsicID = llvm::Intrinsic::sin; break;
+        case Builtin::Cos: intrinsicID = llvm::Intrinsic::cos; break;
+        case Builtin::Exp: intrinsicID = llvm::Intrinsic::exp; break;
+        case Builtin::Log: intrinsicID = llvm::Intrinsic::log; break;
+        case Builtin::Log2: intrinsicID = llvm::Intrinsic::log2; break;
+        case Builtin::Log10: intrinsicID = llvm::Intrinsic::log10; break;
+        default:
+            break;
+    }
+    
+    llvm::Type* f64Ty = llvm::Type::getDoubleTy(*context);
+    if (builtin == Builtin::Tan) {
+        // Note: tan is not an LLVM intrinsic, we'll handle it differently
+        // tan(x) = sin(x) / cos(x)
+        llvm::Function* sinFunc = llvm::Intrinsic::getDeclaration(module.get(), llvm::Intrinsic::sin, {f64Ty});
+        llvm::Function* cosFunc = llvm::Intrinsic::getDeclaration(module.get(), llvm::Intrinsic::cos, {f64Ty});
+        llvm::Value* sinVal = builder->CreateCall(sinFunc, args);
+        llvm::Value* cosVal = builder->CreateCall(cosFunc, args);
+        currentValue = builder->CreateFDiv(sinVal, cosVal, "tanval");
+        return;
+    }
+    
+    // asin, acos and atan are not LLVM intrinsics; they come from libm
+    llvm::Function* mathFunc = intrinsicID != llvm::Intrinsic::not_intrinsic
+        ? llvm::Intrinsic::getDeclaration(module.get(), intrinsicID, {f64Ty})
+        : getOrCreateBuiltin(builtin);
+    currentValue = builder->CreateCall(mathFunc, args, "mathcall");
+}
+
 void CodeGenerator::visit(CallExpr& node) {
-    // Special handling for LLVM intrinsic-based functions
-    if (node.functionName == "pow" || node.functionName == "floor" || 
-        node.functionName == "ceil" || node.functionName == "round" ||
-        node.functionName == "sin" || node.functionName == "cos" || 
-        node.functionName == "tan" || node.functionName == "sqrt" ||
-        node.functionName == "asin" || node.functionName == "acos" || 
-        node.functionName == "atan" || node.functionName == "exp" ||
-        node.functionName == "log" || node.functionName == "log2" || 
-        node.functionName == "log10") {
-        
-        // Evaluate arguments first
-        std::vector<llvm::Value*> args;
-        for (auto& arg : node.arguments) {
-            arg->accept(*this);
-            if (!currentValue) {
-                std::cerr << "Error evaluating argument" << std::endl;
-                currentValue = nullptr;
-                return;
+    bool math = node.binding.kind == Binding::Kind::BUILTIN &&
+                isMathBuiltin(static_cast<Builtin>(node.binding.index));
+    llvm::Function* callee = nullptr;
+    switch (node.binding.kind) {
+        case Binding::Kind::FUNCTION:
+            // Functions are created as they are generated, in program order
+            if (node.binding.index < definedFunctions.size()) {
+                callee = definedFunctions[node.binding.index];
             }
-            args.push_back(currentValue);
-        }
-        
-        // Get the appropriate LLVM intrinsic
-        llvm::Intrinsic::ID intrinsicID;
-        if (node.functionName == "pow") {
-            intrinsicID = llvm::Intrinsic::pow;
-        } else if (node.functionName == "floor") {
-            intrinsicID = llvm::Intrinsic::floor;
-        } else if (node.functionName == "ceil") {
-            intrinsicID = llvm::Intrinsic::ceil;
-        } else if (node.functionName == "round") {
-            intrinsicID = llvm::Intrinsic::round;
-        } else if (node.functionName == "sqrt") {
-            intrinsicID = llvm::Intrinsic::sqrt;
-        } else if (node.functionName == "sin") {
-            intrinsicID = llvm::Intrinsic::sin;
-        } else if (node.functionName == "cos") {
-            intrinsicID = llvm::Intrinsic::cos;
-        } else if (node.functionName == "tan") {
-            // Note: tan is not an LLVM intrinsic, we'll handle it differently
-            // tan(x) = sin(x) / cos(x)
-            llvm::Function* sinFunc = llvm::Intrinsic::getDeclaration(
-                module.get(), llvm::Intrinsic::sin, {llvm::Type::getDoubleTy(*context)});
-            llvm::Function* cosFunc = llvm::Intrinsic::getDeclaration(
-                module.get(), llvm::Intrinsic::cos, {llvm::Type::getDoubleTy(*context)});
-            llvm::Value* sinVal = builder->CreateCall(sinFunc, args);
-            llvm::Value* cosVal = builder->CreateCall(cosFunc, args);
-            currentValue = builder->CreateFDiv(sinVal, cosVal, "tanval");
-            return;
-        } else if (node.functionName == "exp") {
-            intrinsicID = llvm::Intrinsic::exp;
-        } else if (node.functionName == "log") {
-            intrinsicID = llvm::Intrinsic::log;
-        } else if (node.functionName == "log2") {
-            intrinsicID = llvm::Intrinsic::log2;
-        } else if (node.functionName == "log10") {
-            intrinsicID = llvm::Intrinsic::log10;
-        } else {
-            // For asin, acos, atan - these are not LLVM intrinsics
-            // We need to declare them as external C math library functions
-            std::vector<llvm::Type*> paramTypes = {llvm::Type::getDoubleTy(*context)};
-            llvm::FunctionType* mathFuncType = llvm::FunctionType::get(
-                llvm::Type::getDoubleTy(*context), paramTypes, false);
-            llvm::Function* mathFunc = module->getFunction(node.functionName);
-            if (!mathFunc) {
-                mathFunc = llvm::Function::Create(
-                    mathFuncType, llvm::Function::ExternalLinkage, node.functionName, module.get());
+            break;
+        case Binding::Kind::IMPORTED:
+            callee = importedDeclarations[node.binding.index];
+            break;
+        case Binding::Kind::BUILTIN:
+            if (!math) {
+                callee = getOrCreateBuiltin(static_cast<Builtin>(node.binding.index));
             }
-            currentValue = builder->CreateCall(mathFunc, args, "mathcall");
-            return;
-        }
-        
-        llvm::Function* intrinsic = llvm::Intrinsic::getDeclaration(
-            module.get(), intrinsicID, {llvm::Type::getDoubleTy(*context)});
-        currentValue = builder->CreateCall(intrinsic, args, "mathcall");
-        return;
+            break;
+        default:
+            break;
     }
     
-    llvm::Function* callee = module->getFunction(node.functionName);
-    if (!callee) {
-        std::cerr << "Unknown function referenced: " << node.functionName << std::endl;
+    // Entered again after each argument, whose value waits on operandValues
+    // until the call is made
+    uint32_t walked = walker.stage();
+    if (walked == 0 && !callee && !math) {
+        errorOut << "Unknown function referenced: " << getName(node.functionId) << std::endl;
         currentValue = nullptr;
         return;
     }
-    
-    std::vector<llvm::Value*> args;
-    for (auto& arg : node.arguments) {
-        arg->accept(*this);
+    if (walked > 0) {
         if (!currentValue) {
-            std::cerr << "Error evaluating argument" << std::endl;
-            currentValue = nullptr;
+            errorOut << "Error evaluating argument" << std::endl;
+            operandValues.resize(operandValues.size() - (walked - 1));
             return;
         }
-        args.push_back(currentValue);
+        operandValues.push_back(currentValue);
+    }
+    if (walked < node.arguments.size()) {
+        return walker.descend(*node.arguments[walked]);
     }
     
-    // Check if function returns void
-    if (callee->getReturnType()->isVoidTy()) {
+    llvm::ArrayRef<llvm::Value*> args = llvm::ArrayRef<llvm::Value*>(operandValues).take_back(node.arguments.size());
+    if (math) {
+        emitMathBuiltin(static_cast<Builtin>(node.binding.index), args);
+    } else if (callee->getReturnType()->isVoidTy()) {
+        // Check if function returns void
         builder->CreateCall(callee, args);
         currentValue = nullptr; // Void functions don't produce a value
     } else {
         currentValue = builder->CreateCall(callee, args, "calltmp");
     }
+    operandValues.resize(operandValues.size() - node.arguments.size());
 }
 
 } // namespace hash
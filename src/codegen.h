@@ -2,24 +2,109 @@
 #define HASH_CODEGEN_H
 
 #include "ast.h"
+#include "builtins.h"
+#include "incremental.h"
+#include "semantic.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Target/TargetMachine.h>
+#include <iostream>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace hash {
 
+// Optimization level selected with -O0 .. -O3, -Os, -Oz
+enum class OptLevel { O0, O1, O2, O3, Os, Oz };
+
 class CodeGenerator : public ASTVisitor {
 public:
-    CodeGenerator();
+    // Errors are written to errorOut, so a batch compilation can keep each
+    // file's messages together
+    explicit CodeGenerator(std::ostream& errorOut = std::cerr);
     ~CodeGenerator();
     
+    // Registers the host's LLVM backend. Runs once per process, however
+    // many generators (e.g. one per file of a batch compilation) are created.
+    // Other backends are only registered when setTargetTriple asks for one.
+    static void initializeTargets();
+    
     bool generate(Program& program, const std::string& moduleName);
     void emitObjectFile(const std::string& filename);
+    bool emitObject(llvm::SmallVectorImpl<char>& buffer);
+    // Like emitObject, but splits the module into one partition per codegen
+    // thread and emits an object for each in parallel. All of them must be
+    // linked together.
+    bool emitObjects(std::vector<llvm::SmallVector<char, 0>>& objects);
+    // Incremental builds: one object per recompiled function, plus the stored
+    // objects of unchanged ones and an object holding the global variables.
+    // Each new function is optimized on its own, with every other function
+    // only declared, so no object depends on another function's body.
+    bool emitIncrementalObjects(std::vector<llvm::SmallVector<char, 0>>& objects);
     void emitLLVMIR(const std::string& filename);
+    
+    // Modules of a multi-file program (see ModuleGraph). Each one is
+    // generated by its own CodeGenerator, optimized with the ThinLTO pre-link
+    // pipeline and written as bitcode with a summary; thinLink then imports
+    // functions across modules, so calls into other modules still inline,
+    // and generates an object per module in parallel.
+    void setThinLTO(bool enabled) { thinLTO = enabled; }
+    bool emitThinLTOBitcode(llvm::SmallVectorImpl<char>& buffer);
+    bool thinLink(const std::vector<llvm::SmallVector<char, 0>>& modules,
+                  std::vector<llvm::SmallVector<char, 0>>& objects);
+    // Links other modules' bitcode into this module and optimizes the result
+    // as a whole, for the JIT and IR output of multi-file programs
+    bool linkModules(const std::vector<llvm::SmallVector<char, 0>>& modules);
+    // Functions defined by imported modules, declared so calls to them
+    // resolve at link time
+    void setImportedFunctions(const std::vector<FunctionInfo>& imported) { importedFunctions = imported; }
+    
+    // JIT-compiles the module in-process and calls main(). Consumes the
+    // module; returns false if the JIT could not be set up.
+    bool runJIT(int& exitCode);
+    // Runs an object the JIT compiled on an earlier run (see setObjectCache)
+    // without needing a module
+    bool runJITObject(std::unique_ptr<llvm::MemoryBuffer> object, int& exitCode);
     llvm::Module* getModule() { return module.get(); }
+    std::string getTargetTriple() const { return module->getTargetTriple().str(); }
+    // Triple, CPU and features code will be generated for, with "native"
+    // resolved; empty if the target is unavailable
+    std::string describeTarget();
+    
+    void setOptLevel(OptLevel level) { optLevel = level; }
+    OptLevel getOptLevel() const { return optLevel; }
+    
+    // Triple to generate code for; empty for the host
+    void setTargetTriple(const std::string& triple) { targetTriple = triple; }
+    
+    // CPU name or "native"; empty picks native for optimized host builds, generic otherwise
+    void setTargetCPU(const std::string& cpu) { targetCPU = cpu; }
+    // Comma-separated LLVM feature list, e.g. "+avx2,-avx512f"
+    void setTargetFeatures(const std::string& features) { targetFeatures = features; }
+    
+    // Instrument every function with PGO counters; the program writes them
+    // to this .profraw file at exit (LLVM_PROFILE_FILE overrides it)
+    void setProfileGenerate(const std::string& rawProfile) { profileGenerate = rawProfile; }
+    // Optimize with a profile merged by llvm-profdata: branch weights,
+    // inlining and hot/cold function placement follow the recorded counts
+    void setProfileUse(const std::string& profile) { profileUse = profile; }
+    
+    // Number of threads for machine code generation; 0 uses every core
+    void setCodegenThreads(unsigned threads) { codegenThreads = threads; }
+    
+    // Compile function by function, reusing the stored object of every
+    // function whose fingerprint is unchanged (see emitIncrementalObjects);
+    // not owned
+    void setIncrementalStore(IncrementalStore* store) { incrementalStore = store; }
+    
+    // Receives the object runJIT compiles; not owned
+    void setObjectCache(llvm::ObjectCache* cache) { objectCache = cache; }
     
     // Visitor methods
     void visit(IntegerLiteral& node) override;
@@ -42,17 +127,70 @@ public:
     void visit(Program& node) override;
     
 private:
+    std::ostream& errorOut;
     std::unique_ptr<llvm::LLVMContext> context;
+    std::unordered_map<const Type*, llvm::Type*> llvmTypes; // In context
     std::unique_ptr<llvm::Module> module;
     std::unique_ptr<llvm::IRBuilder<>> builder;
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
+    OptLevel optLevel;
+    std::string targetTriple;
+    std::string targetCPU;
+    std::string targetFeatures;
+    std::string profileGenerate;
+    std::string profileUse;
+    unsigned codegenThreads;
+    bool thinLTO;
+    std::vector<FunctionInfo> importedFunctions;
+    llvm::ObjectCache* objectCache;
+    IncrementalStore* incrementalStore;
     
-    std::unordered_map<std::string, llvm::AllocaInst*> namedValues;
+    // Values of the bindings SemanticAnalyzer resolved names to, indexed
+    // like Binding::index
+    std::vector<llvm::AllocaInst*> localSlots; // Of the current function
+    std::vector<llvm::GlobalVariable*> globalVariables;
+    std::vector<llvm::Function*> definedFunctions;
+    std::vector<llvm::Function*> importedDeclarations;
+    std::vector<llvm::Function*> builtinFunctions; // Null until first called
     std::unordered_map<std::string, llvm::Function*> functions;
     
     llvm::Value* currentValue;
     llvm::Function* currentFunction;
+    // Walks the expressions of statements. Operands a node still needs
+    // once its last one has been walked wait on operandValues.
+    ExpressionWalker walker;
+    std::vector<llvm::Value*> operandValues;
+    // Of the program being generated
+    const IdentifierTable* identifiers = nullptr;
+    const std::string& getName(IdentifierId id) const { return identifiers->getName(id); }
+    
+    // Registers every backend hashc was built with; false if it only has
+    // the host's (HASH_HOST_TARGET_ONLY)
+    static bool initializeAllTargets();
+    bool isHostTarget() const;
+    bool createTargetMachine();
+    // A fresh target machine for the resolved CPU and features. Each
+    // codegen thread needs its own, since they are not thread-safe.
+    std::unique_ptr<llvm::TargetMachine> newTargetMachine() const;
+    // LLJIT for the target machine, with libc and libhashrt symbols available
+    llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> createJIT();
+    bool runJITEntry(llvm::orc::LLJIT& jit, int& exitCode);
+    // Links the libhashrt functions the module calls from the embedded bitcode
+    bool linkRuntime();
+    
+    // Builtins and the libc functions they use are emitted on first call
+    llvm::Function* getOrCreateBuiltin(Builtin builtin);
+    llvm::Function* emitBuiltin(Builtin builtin);
+    llvm::Function* getLibcFunction(const std::string& name);
+    // Calls a math builtin, which lowers to an LLVM intrinsic or libm (see
+    // isMathBuiltin), on the argument values
+    void emitMathBuiltin(Builtin builtin, llvm::ArrayRef<llvm::Value*> args);
+    // The alloca or global a variable binding refers to; null if unresolved
+    llvm::Value* getVariable(const Binding& binding) const;
+    void optimize(llvm::Module& target);
+    bool emitModuleObject(llvm::Module& target, llvm::TargetMachine& machine, llvm::SmallVectorImpl<char>& buffer);
     
-    llvm::Type* getLLVMType(const std::shared_ptr<Type>& type);
+    llvm::Type* getLLVMType(const Type* type);
     llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* function, const std::string& varName, llvm::Type* type);
 };
 
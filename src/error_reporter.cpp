@@ -15,7 +15,7 @@ namespace hash {
 #define WHITE   "\033[37m"
 #define GRAY    "\033[90m"
 
-ErrorReporter::ErrorReporter(const std::string& sourceCode, const std::string& filename)
+ErrorReporter::ErrorReporter(std::string_view sourceCode, const std::string& filename)
     : sourceCode(sourceCode), filename(filename) {}
 
 void ErrorReporter::error(const std::string& message, int line, int column, int length) {
@@ -38,21 +38,22 @@ void ErrorReporter::addSuggestion(const std::string& suggestion) {
     }
 }
 
-std::string ErrorReporter::getSourceLine(int lineNumber) const {
+std::string_view ErrorReporter::getSourceLine(int lineNumber) const {
     if (lineNumber < 1) return "";
     
-    std::istringstream iss(sourceCode);
-    std::string line;
-    int currentLine = 1;
-    
-    while (std::getline(iss, line)) {
-        if (currentLine == lineNumber) {
-            return line;
-        }
-        currentLine++;
+    size_t start = 0;
+    for (int currentLine = 1; currentLine < lineNumber; currentLine++) {
+        start = sourceCode.find('\n', start);
+        if (start == std::string_view::npos) return "";
+        start++;
     }
+    if (start >= sourceCode.size()) return "";
     
-    return "";
+    std::string_view line = sourceCode.substr(start, sourceCode.find('\n', start) - start);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
 }
 
 std::string ErrorReporter::createUnderline(int column, int length) const {
@@ -84,58 +85,58 @@ std::string ErrorReporter::getLevelColor(DiagnosticLevel level) const {
     }
 }
 
-void ErrorReporter::printDiagnostic(const Diagnostic& diag) const {
+void ErrorReporter::printDiagnostic(const Diagnostic& diag, std::ostream& out) const {
     // Print: error: message
-    std::cerr << getLevelColor(diag.level) << getLevelString(diag.level) << ": "
+    out << getLevelColor(diag.level) << getLevelString(diag.level) << ": "
               << RESET BOLD << diag.message << RESET << "\n";
     
     // Print: --> filename:line:column
     if (diag.line >= 1) {
-        std::cerr << BOLD BLUE << "  --> " << RESET 
+        out << BOLD BLUE << "  --> " << RESET 
                   << diag.filename << ":" << diag.line << ":" << diag.column << "\n";
         
         // Print the source line with line number
-        std::string sourceLine = getSourceLine(diag.line);
+        std::string_view sourceLine = getSourceLine(diag.line);
         if (!sourceLine.empty()) {
-            std::cerr << BOLD BLUE << std::setw(5) << diag.line << " | " << RESET
+            out << BOLD BLUE << std::setw(5) << diag.line << " | " << RESET
                       << sourceLine << "\n";
             
             // Print underline pointing to the error
-            std::cerr << BOLD BLUE << "      | " << RESET
+            out << BOLD BLUE << "      | " << RESET
                       << createUnderline(diag.column, diag.length) << "\n";
         }
     }
     
     // Print suggestion if available
     if (!diag.suggestion.empty()) {
-        std::cerr << BOLD CYAN << "  help: " << RESET << diag.suggestion << "\n";
+        out << BOLD CYAN << "  help: " << RESET << diag.suggestion << "\n";
     }
     
-    std::cerr << "\n";
+    out << "\n";
 }
 
-void ErrorReporter::printDiagnostics() const {
+void ErrorReporter::printDiagnostics(std::ostream& out) const {
     if (diagnostics.empty()) return;
     
     for (const auto& diag : diagnostics) {
-        printDiagnostic(diag);
+        printDiagnostic(diag, out);
     }
     
     // Print summary
     if (errorCount > 0 || warningCount > 0) {
-        std::cerr << BOLD;
+        out << BOLD;
         if (errorCount > 0) {
-            std::cerr << RED << "✗ " << errorCount << " error" 
+            out << RED << "✗ " << errorCount << " error" 
                       << (errorCount > 1 ? "s" : "") << RESET;
         }
         if (errorCount > 0 && warningCount > 0) {
-            std::cerr << ", ";
+            out << ", ";
         }
         if (warningCount > 0) {
-            std::cerr << BOLD YELLOW << "⚠ " << warningCount << " warning" 
+            out << BOLD YELLOW << "⚠ " << warningCount << " warning" 
                       << (warningCount > 1 ? "s" : "") << RESET;
         }
-        std::cerr << " generated.\n";
+        out << " generated.\n";
     }
 }
 
@@ -1,5 +1,7 @@
 #pragma once
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -28,7 +30,8 @@ struct Diagnostic {
 
 class ErrorReporter {
 public:
-    ErrorReporter(const std::string& sourceCode, const std::string& filename);
+    // Keeps a view of the source, which must outlive the reporter
+    ErrorReporter(std::string_view sourceCode, const std::string& filename);
     
     void error(const std::string& message, int line, int column, int length = 1);
     void warning(const std::string& message, int line, int column, int length = 1);
@@ -36,8 +39,8 @@ public:
     
     void addSuggestion(const std::string& suggestion);
     
-    void printDiagnostics() const;
-    void printDiagnostic(const Diagnostic& diag) const;
+    void printDiagnostics(std::ostream& out = std::cerr) const;
+    void printDiagnostic(const Diagnostic& diag, std::ostream& out = std::cerr) const;
     
     bool hasErrors() const { return errorCount > 0; }
     int getErrorCount() const { return errorCount; }
@@ -46,13 +49,13 @@ public:
     const std::vector<Diagnostic>& getDiagnostics() const { return diagnostics; }
     
 private:
-    std::string sourceCode;
+    std::string_view sourceCode;
     std::string filename;
     std::vector<Diagnostic> diagnostics;
     int errorCount = 0;
     int warningCount = 0;
     
-    std::string getSourceLine(int lineNumber) const;
+    std::string_view getSourceLine(int lineNumber) const;
     std::string createUnderline(int column, int length) const;
     std::string getLevelString(DiagnosticLevel level) const;
     std::string getLevelColor(DiagnosticLevel level) const;
@@ -0,0 +1,21 @@
+#include "identifiers.h"
+
+namespace hash {
+
+IdentifierId IdentifierTable::intern(std::string_view name) {
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    IdentifierId id = static_cast<IdentifierId>(names.size());
+    names.emplace_back(name);
+    ids.emplace(names.back(), id);
+    return id;
+}
+
+IdentifierId IdentifierTable::lookup(std::string_view name) const {
+    auto it = ids.find(name);
+    return it != ids.end() ? it->second : NoIdentifier;
+}
+
+} // namespace hash
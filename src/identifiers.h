@@ -0,0 +1,38 @@
+#ifndef HASH_IDENTIFIERS_H
+#define HASH_IDENTIFIERS_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace hash {
+
+// An interned identifier. Ids are dense, starting at 0, so later passes can
+// index arrays by them instead of hashing names.
+using IdentifierId = uint32_t;
+constexpr IdentifierId NoIdentifier = UINT32_MAX;
+
+// Every identifier of one compilation. The lexer interns each identifier
+// as it scans it; once lexing is done the table is only read, so analyzers
+// running on several threads can share it.
+class IdentifierTable {
+public:
+    // The id of name, assigning the next one the first time name is seen
+    IdentifierId intern(std::string_view name);
+    // The id of name, or NoIdentifier if it never occurred
+    IdentifierId lookup(std::string_view name) const;
+
+    const std::string& getName(IdentifierId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+private:
+    // A deque never moves its strings, so the map can key views into them
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, IdentifierId> ids;
+};
+
+} // namespace hash
+
+#endif // HASH_IDENTIFIERS_H
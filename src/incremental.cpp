@@ -0,0 +1,286 @@
+#include "incremental.h"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/raw_ostream.h>
+#include <filesystem>
+#include <set>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace hash {
+
+namespace {
+
+std::string describeType(const Type* type) {
+    if (!type) {
+        return "?";
+    }
+    std::string result = std::to_string(static_cast<int>(type->kind));
+    if (type->elementType) {
+        result += "[" + describeType(type->elementType) + ";" + std::to_string(type->arraySize) + "]";
+    }
+    if (type->kind == Type::Kind::FUNCTION) {
+        result += "(";
+        for (const auto& param : type->paramTypes) {
+            result += describeType(param) + ",";
+        }
+        result += ")" + describeType(type->returnType);
+    }
+    if (!type->structName.empty()) {
+        result += "{" + type->structName + "}";
+    }
+    return result;
+}
+
+std::string describeSignature(const FunctionDecl& func, const IdentifierTable& identifiers) {
+    std::string result = identifiers.getName(func.id) + (func.isPure ? " pure(" : "(");
+    for (const auto& param : func.parameters) {
+        result += describeType(param.type) + ",";
+    }
+    return result + ")" + describeType(func.returnType);
+}
+
+// Writes everything about a function body that reaches code generation:
+// the tree shape, literal values and the types semantic analysis assigned.
+// Names that are neither parameters nor locals are recorded as dependencies
+// on a global or another function, whose signature is hashed separately.
+class FingerprintWriter : public ASTVisitor {
+public:
+    // Names go into the text by spelling, since ids change whenever
+    // identifiers are added or removed anywhere earlier in the file
+    explicit FingerprintWriter(const IdentifierTable& identifiers) : identifiers(identifiers) {}
+
+    std::string text;
+    std::set<std::string> calledFunctions;
+    std::set<std::string> usedGlobals;
+
+    void write(FunctionDecl& node) {
+        text += describeSignature(node, identifiers) + "{";
+        for (const auto& param : node.parameters) {
+            text += identifiers.getName(param.id) + ",";
+            locals.insert(param.id);
+        }
+        writeBody(node.body);
+        text += "}";
+    }
+
+    void visit(IntegerLiteral& node) override {
+        text += "i" + std::to_string(node.value) + ":" + describeType(node.type) + " ";
+    }
+    void visit(FloatLiteral& node) override {
+        // Hex so the fingerprint sees every bit of the value
+        text += "f" + llvm::utohexstr(llvm::bit_cast<uint64_t>(node.value)) + " ";
+    }
+    void visit(StringLiteral& node) override {
+        text += "s" + std::to_string(node.value.size()) + ":" + node.value + " ";
+    }
+    void visit(BoolLiteral& node) override {
+        text += node.value ? "true " : "false ";
+    }
+    void visit(Identifier& node) override {
+        text += "id " + identifiers.getName(node.id) + ":" + describeType(node.type) + " ";
+        use(node.id);
+    }
+    void visit(BinaryOp& node) override {
+        switch (walker.stage()) {
+            case 0:
+                text += "(b" + std::to_string(static_cast<int>(node.op)) + ":" + describeType(node.type) + " ";
+                return walker.descend(*node.left);
+            case 1:
+                return walker.descend(*node.right);
+        }
+        text += ")";
+    }
+    void visit(UnaryOp& node) override {
+        if (walker.stage() == 0) {
+            text += "(u" + std::to_string(static_cast<int>(node.op)) + ":" + describeType(node.type) + " ";
+            return walker.descend(*node.operand);
+        }
+        text += ")";
+    }
+    void visit(CallExpr& node) override {
+        uint32_t walked = walker.stage();
+        if (walked == 0) {
+            const std::string& name = identifiers.getName(node.functionId);
+            text += "(call " + name + ":" + describeType(node.type) + " ";
+            calledFunctions.insert(name);
+        }
+        if (walked < node.arguments.size()) {
+            return walker.descend(*node.arguments[walked]);
+        }
+        text += ")";
+    }
+
+    void visit(VariableDecl& node) override {
+        text += std::string("(let") + (node.isMutable ? " mut " : " ") + identifiers.getName(node.id) + ":" +
+                describeType(node.varType) + " ";
+        if (node.initializer) {
+            walker.walk(*node.initializer, *this);
+        }
+        text += ")";
+        locals.insert(node.id);
+    }
+    void visit(Assignment& node) override {
+        text += "(set " + identifiers.getName(node.id) + " ";
+        use(node.id);
+        walker.walk(*node.value, *this);
+        text += ")";
+    }
+    void visit(ReturnStmt& node) override {
+        text += "(return ";
+        if (node.value) {
+            walker.walk(*node.value, *this);
+        }
+        text += ")";
+    }
+    void visit(IfStmt& node) override {
+        text += "(if ";
+        walker.walk(*node.condition, *this);
+        writeBody(node.thenBody);
+        text += "else";
+        writeBody(node.elseBody);
+        text += ")";
+    }
+    void visit(WhileStmt& node) override {
+        text += "(while ";
+        walker.walk(*node.condition, *this);
+        writeBody(node.body);
+        text += ")";
+    }
+    void visit(ExprStmt& node) override {
+        text += "(expr ";
+        walker.walk(*node.expression, *this);
+        text += ")";
+    }
+
+    void visit(FunctionDecl& node) override { write(node); }
+    void visit(Program&) override {}
+
+private:
+    const IdentifierTable& identifiers;
+    // Codegen keeps one flat table of locals per function, so a name stays
+    // local from its declaration to the end of the function
+    std::unordered_set<IdentifierId> locals;
+    ExpressionWalker walker;
+
+    void use(IdentifierId id) {
+        if (!locals.count(id)) {
+            usedGlobals.insert(identifiers.getName(id));
+        }
+    }
+
+    void writeBody(const NodeList<Statement*>& body) {
+        text += "[";
+        for (auto& stmt : body) {
+            stmt->accept(*this);
+        }
+        text += "]";
+    }
+};
+
+} // namespace
+
+IncrementalStore::IncrementalStore(const std::string& directory, const std::string& configuration)
+    : directory(directory), configuration(configuration) {
+    llvm::sys::fs::create_directories(directory);
+}
+
+void IncrementalStore::fingerprint(Program& program) {
+    std::unordered_map<std::string, std::string> signatures;
+    for (const auto& func : program.functions) {
+        signatures[program.getName(func->id)] = describeSignature(*func, *program.identifiers);
+    }
+    std::unordered_map<std::string, std::string> globals;
+    for (const auto& global : program.globals) {
+        globals[program.getName(global->id)] = describeType(global->varType);
+    }
+
+    fingerprints.clear();
+    for (const auto& func : program.functions) {
+        FingerprintWriter writer(*program.identifiers);
+        writer.write(*func);
+
+        llvm::SHA256 hasher;
+        hasher.update(configuration);
+        hasher.update(llvm::StringRef("\0", 1));
+        hasher.update(writer.text);
+        // Builtins are covered by the hashc build identity in the configuration
+        for (const auto& callee : writer.calledFunctions) {
+            auto it = signatures.find(callee);
+            hasher.update(llvm::StringRef("\0", 1));
+            hasher.update(it != signatures.end() ? it->second : "builtin " + callee);
+        }
+        for (const auto& name : writer.usedGlobals) {
+            auto it = globals.find(name);
+            hasher.update(llvm::StringRef("\0", 1));
+            hasher.update("global " + name + ":" + (it != globals.end() ? it->second : "?"));
+        }
+        fingerprints[program.getName(func->id)] = llvm::toHex(hasher.final(), /*LowerCase=*/true);
+    }
+}
+
+std::string IncrementalStore::getObjectPath(const std::string& function) const {
+    auto it = fingerprints.find(function);
+    if (it == fingerprints.end()) {
+        return "";
+    }
+    llvm::SmallString<128> path(directory);
+    llvm::sys::path::append(path, it->second + ".o");
+    return std::string(path);
+}
+
+bool IncrementalStore::has(const std::string& function) const {
+    std::string path = getObjectPath(function);
+    return !path.empty() && llvm::sys::fs::exists(path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> IncrementalStore::load(const std::string& function) const {
+    std::string path = getObjectPath(function);
+    if (path.empty()) {
+        return nullptr;
+    }
+    auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        return nullptr;
+    }
+    return std::move(*buffer);
+}
+
+bool IncrementalStore::store(const std::string& function, llvm::ArrayRef<char> object) {
+    std::string path = getObjectPath(function);
+    if (path.empty()) {
+        return false;
+    }
+    // Rename into place so an interrupted build never leaves a truncated
+    // object under a valid fingerprint
+    std::string tempPath = path + ".tmp";
+    {
+        std::error_code EC;
+        llvm::raw_fd_ostream out(tempPath, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            return false;
+        }
+        out.write(object.data(), object.size());
+    }
+    return !llvm::sys::fs::rename(tempPath, path);
+}
+
+void IncrementalStore::prune() {
+    std::unordered_set<std::string> live;
+    for (const auto& entry : fingerprints) {
+        live.insert(entry.second + ".o");
+    }
+    std::error_code EC;
+    for (const auto& file : fs::directory_iterator(directory, EC)) {
+        if (file.is_regular_file(EC) && !live.count(file.path().filename().string())) {
+            fs::remove(file.path(), EC);
+        }
+    }
+}
+
+} // namespace hash
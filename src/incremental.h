@@ -0,0 +1,47 @@
+#ifndef HASH_INCREMENTAL_H
+#define HASH_INCREMENTAL_H
+
+#include "ast.h"
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace hash {
+
+// Per-function machine code kept between builds of one module.
+//
+// After semantic analysis every function gets a fingerprint over its typed
+// body, the signatures of the functions it calls, the types of the globals
+// it touches and the build configuration. Each function is compiled to its
+// own object named by that fingerprint, so a rebuild only has to generate
+// code for functions whose fingerprint changed and can link the stored
+// objects for the rest.
+class IncrementalStore {
+public:
+    // configuration covers everything outside the source that affects code
+    // (hashc build identity, target, optimization level)
+    IncrementalStore(const std::string& directory, const std::string& configuration);
+
+    void fingerprint(Program& program);
+
+    // True if an object for the function's current fingerprint is stored
+    bool has(const std::string& function) const;
+    std::unique_ptr<llvm::MemoryBuffer> load(const std::string& function) const;
+    bool store(const std::string& function, llvm::ArrayRef<char> object);
+
+    // Deletes stored objects that no function of the program uses anymore
+    void prune();
+
+private:
+    std::string directory;
+    std::string configuration;
+    std::unordered_map<std::string, std::string> fingerprints;
+
+    std::string getObjectPath(const std::string& function) const;
+};
+
+} // namespace hash
+
+#endif // HASH_INCREMENTAL_H
@@ -2,62 +2,219 @@
 #include <cctype>
 #include <stdexcept>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASH_LEXER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace hash {
 
-std::unordered_map<std::string, TokenType> Lexer::keywords = {
-    {"fn", TokenType::FN},
-    {"pure", TokenType::PURE},
-    {"let", TokenType::LET},
-    {"mut", TokenType::MUT},
-    {"if", TokenType::IF},
-    {"else", TokenType::ELSE},
-    {"while", TokenType::WHILE},
-    {"for", TokenType::FOR},
-    {"return", TokenType::RETURN},
-    {"import", TokenType::IMPORT},
-    {"struct", TokenType::STRUCT},
-    {"enum", TokenType::ENUM},
-    {"match", TokenType::MATCH},
-    {"true", TokenType::TRUE},
-    {"false", TokenType::FALSE},
-    
-    // Types
-    {"i8", TokenType::TYPE_I8},
-    {"i16", TokenType::TYPE_I16},
-    {"i32", TokenType::TYPE_I32},
-    {"i64", TokenType::TYPE_I64},
-    {"u8", TokenType::TYPE_U8},
-    {"u16", TokenType::TYPE_U16},
-    {"u32", TokenType::TYPE_U32},
-    {"u64", TokenType::TYPE_U64},
-    {"f32", TokenType::TYPE_F32},
-    {"f64", TokenType::TYPE_F64},
-    {"bool", TokenType::TYPE_BOOL},
-    {"void", TokenType::TYPE_VOID},
-    {"str", TokenType::TYPE_STR},
-    
-    // Access modifiers
-    {"pure_local", TokenType::PURE_LOCAL},
-    {"side_effect", TokenType::SIDE_EFFECT},
+namespace {
+
+// Keywords switched on length and then first character, so telling an
+// identifier from a keyword costs a compare or two and never hashes it
+TokenType lookupKeyword(std::string_view word) {
+    switch (word.size()) {
+        case 2:
+            switch (word[0]) {
+                case 'f': if (word == "fn") return TokenType::FN; break;
+                case 'i':
+                    if (word == "if") return TokenType::IF;
+                    if (word == "i8") return TokenType::TYPE_I8;
+                    break;
+                case 'u': if (word == "u8") return TokenType::TYPE_U8; break;
+            }
+            break;
+        case 3:
+            switch (word[0]) {
+                case 'l': if (word == "let") return TokenType::LET; break;
+                case 'm': if (word == "mut") return TokenType::MUT; break;
+                case 's': if (word == "str") return TokenType::TYPE_STR; break;
+                case 'f':
+                    if (word == "for") return TokenType::FOR;
+                    if (word == "f32") return TokenType::TYPE_F32;
+                    if (word == "f64") return TokenType::TYPE_F64;
+                    break;
+                case 'i':
+                    if (word == "i16") return TokenType::TYPE_I16;
+                    if (word == "i32") return TokenType::TYPE_I32;
+                    if (word == "i64") return TokenType::TYPE_I64;
+                    break;
+                case 'u':
+                    if (word == "u16") return TokenType::TYPE_U16;
+                    if (word == "u32") return TokenType::TYPE_U32;
+                    if (word == "u64") return TokenType::TYPE_U64;
+                    break;
+            }
+            break;
+        case 4:
+            switch (word[0]) {
+                case 'p': if (word == "pure") return TokenType::PURE; break;
+                case 't': if (word == "true") return TokenType::TRUE; break;
+                case 'b': if (word == "bool") return TokenType::TYPE_BOOL; break;
+                case 'v': if (word == "void") return TokenType::TYPE_VOID; break;
+                case 'e':
+                    if (word == "else") return TokenType::ELSE;
+                    if (word == "enum") return TokenType::ENUM;
+                    break;
+            }
+            break;
+        case 5:
+            switch (word[0]) {
+                case 'w': if (word == "while") return TokenType::WHILE; break;
+                case 'm': if (word == "match") return TokenType::MATCH; break;
+                case 'f': if (word == "false") return TokenType::FALSE; break;
+            }
+            break;
+        case 6:
+            switch (word[0]) {
+                case 'r': if (word == "return") return TokenType::RETURN; break;
+                case 'i': if (word == "import") return TokenType::IMPORT; break;
+                case 's': if (word == "struct") return TokenType::STRUCT; break;
+            }
+            break;
+        case 10: if (word == "pure_local") return TokenType::PURE_LOCAL; break;
+        case 11: if (word == "side_effect") return TokenType::SIDE_EFFECT; break;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+#ifdef HASH_LEXER_SSE2
+// Bytes of chunk in [low, high]. Bytes >= 0x80 compare as negative, so
+// they never match an ASCII range.
+__m128i inRange(__m128i chunk, char low, char high) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+}
+
+unsigned lowestSetBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Character classes for scanWhile. Under SSE2 each also tests 16 bytes at
+// once, giving 0xFF for the bytes in the class.
+struct IdentifierChars {
+    static bool contains(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') || c == '_';
+    }
+#ifdef HASH_LEXER_SSE2
+    static __m128i contains(__m128i chunk) {
+        __m128i letters = _mm_or_si128(inRange(chunk, 'a', 'z'), inRange(chunk, 'A', 'Z'));
+        __m128i others = _mm_or_si128(inRange(chunk, '0', '9'),
+                                      _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+        return _mm_or_si128(letters, others);
+    }
+#endif
 };
 
-Lexer::Lexer(const std::string& source)
-    : source(source), pos(0), line(1), column(1), currentIndent(0) {
+struct Digits {
+    static bool contains(char c) { return c >= '0' && c <= '9'; }
+#ifdef HASH_LEXER_SSE2
+    static __m128i contains(__m128i chunk) { return inRange(chunk, '0', '9'); }
+#endif
+};
+
+// Indentation
+struct Spaces {
+    static bool contains(char c) { return c == ' '; }
+#ifdef HASH_LEXER_SSE2
+    static __m128i contains(__m128i chunk) { return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')); }
+#endif
+};
+
+struct Blanks {
+    static bool contains(char c) { return c == ' ' || c == '\t'; }
+#ifdef HASH_LEXER_SSE2
+    static __m128i contains(__m128i chunk) {
+        return _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                            _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+    }
+#endif
+};
+
+// Everything up to the end of the line, for comments
+struct LineChars {
+    static bool contains(char c) { return c != '\n' && c != '\r'; }
+#ifdef HASH_LEXER_SSE2
+    static __m128i contains(__m128i chunk) {
+        __m128i lineEnds = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+                                        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+        return _mm_xor_si128(lineEnds, _mm_set1_epi8(-1));
+    }
+#endif
+};
+
+// Index of the first character at or after pos that is not in Class, or
+// text.size()
+template <typename Class>
+size_t scanWhile(std::string_view text, size_t pos) {
+#ifdef HASH_LEXER_SSE2
+    while (pos + 16 <= text.size()) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+        unsigned outside = ~static_cast<unsigned>(_mm_movemask_epi8(Class::contains(chunk))) & 0xFFFF;
+        if (outside != 0) {
+            return pos + lowestSetBit(outside);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < text.size() && Class::contains(text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+} // namespace
+
+Lexer::Lexer(std::string_view source, IdentifierTable& identifiers, int firstLine)
+    : source(source), identifiers(identifiers), pos(0), line(firstLine), column(1), currentIndent(0),
+      atLineStart(true), pendingIndent(false), pendingDedents(0),
+      pendingIndentError(false), tokenStart(0), tokenLine(firstLine), tokenColumn(1) {
     indentStack.push_back(0);
 }
 
 std::vector<Token> Lexer::tokenize() {
     std::vector<Token> tokens;
-    bool atLineStart = true;
-    
-    while (!isAtEnd()) {
+    do {
+        tokens.push_back(next());
+    } while (tokens.back().type != TokenType::END_OF_FILE);
+    return tokens;
+}
+
+Token Lexer::next() {
+    while (true) {
+        // Tokens queued by handleIndentation come first
+        if (pendingIndent) {
+            pendingIndent = false;
+            return makeToken(TokenType::INDENT);
+        }
+        if (pendingDedents > 0) {
+            pendingDedents--;
+            return makeToken(TokenType::DEDENT);
+        }
+        if (pendingIndentError) {
+            pendingIndentError = false;
+            return makeToken(TokenType::INVALID);
+        }
+        
+        if (isAtEnd()) break;
+        
         // Handle indentation at the start of a line
         if (atLineStart && peek() != '\n' && peek() != '\r') {
-            int spaces = 0;
-            while (peek() == ' ') {
-                advance();
-                spaces++;
-            }
+            size_t indentEnd = scanWhile<Spaces>(source, pos);
+            int spaces = static_cast<int>(indentEnd - pos);
+            skipTo(indentEnd);
             
             // Skip empty lines or comment-only lines
             if (peek() == '\n' || peek() == '\r' || peek() == '#') {
@@ -67,9 +224,10 @@ std::vector<Token> Lexer::tokenize() {
                     continue;
                 }
             } else {
-                auto indentTokens = handleIndentation(spaces);
-                tokens.insert(tokens.end(), indentTokens.begin(), indentTokens.end());
+                beginToken();
+                handleIndentation(spaces);
                 atLineStart = false;
+                continue;
             }
         }
         
@@ -78,6 +236,7 @@ std::vector<Token> Lexer::tokenize() {
         if (isAtEnd()) break;
         
         char c = peek();
+        beginToken();
         
         // Skip comments
         if (c == '#') {
@@ -94,142 +253,132 @@ std::vector<Token> Lexer::tokenize() {
         
         // Numbers
         if (isDigit(c)) {
-            tokens.push_back(readNumber());
-            continue;
+            return readNumber();
         }
         
         // Strings
         if (c == '"' || c == '\'') {
-            tokens.push_back(readString());
-            continue;
+            return readString();
         }
         
         // Identifiers and keywords
         if (isAlpha(c) || c == '_') {
-            tokens.push_back(readIdentifier());
-            continue;
+            return readIdentifier();
         }
         
         // Operators and delimiters
         switch (c) {
-            case '+': tokens.push_back(makeToken(TokenType::PLUS, std::string(1, advance()))); break;
-            case '*': tokens.push_back(makeToken(TokenType::MULTIPLY, std::string(1, advance()))); break;
-            case '%': tokens.push_back(makeToken(TokenType::MODULO, std::string(1, advance()))); break;
-            case '(': tokens.push_back(makeToken(TokenType::LPAREN, std::string(1, advance()))); break;
-            case ')': tokens.push_back(makeToken(TokenType::RPAREN, std::string(1, advance()))); break;
-            case '{': tokens.push_back(makeToken(TokenType::LBRACE, std::string(1, advance()))); break;
-            case '}': tokens.push_back(makeToken(TokenType::RBRACE, std::string(1, advance()))); break;
-            case '[': tokens.push_back(makeToken(TokenType::LBRACKET, std::string(1, advance()))); break;
-            case ']': tokens.push_back(makeToken(TokenType::RBRACKET, std::string(1, advance()))); break;
-            case ',': tokens.push_back(makeToken(TokenType::COMMA, std::string(1, advance()))); break;
-            case ';': tokens.push_back(makeToken(TokenType::SEMICOLON, std::string(1, advance()))); break;
-            case ':': tokens.push_back(makeToken(TokenType::COLON, std::string(1, advance()))); break;
-            case '.': tokens.push_back(makeToken(TokenType::DOT, std::string(1, advance()))); break;
-            case '~': tokens.push_back(makeToken(TokenType::BITWISE_NOT, std::string(1, advance()))); break;
+            case '+': advance(); return makeToken(TokenType::PLUS);
+            case '*': advance(); return makeToken(TokenType::MULTIPLY);
+            case '%': advance(); return makeToken(TokenType::MODULO);
+            case '(': advance(); return makeToken(TokenType::LPAREN);
+            case ')': advance(); return makeToken(TokenType::RPAREN);
+            case '{': advance(); return makeToken(TokenType::LBRACE);
+            case '}': advance(); return makeToken(TokenType::RBRACE);
+            case '[': advance(); return makeToken(TokenType::LBRACKET);
+            case ']': advance(); return makeToken(TokenType::RBRACKET);
+            case ',': advance(); return makeToken(TokenType::COMMA);
+            case ';': advance(); return makeToken(TokenType::SEMICOLON);
+            case ':': advance(); return makeToken(TokenType::COLON);
+            case '.': advance(); return makeToken(TokenType::DOT);
+            case '~': advance(); return makeToken(TokenType::BITWISE_NOT);
             
             case '-':
                 advance();
                 if (peek() == '>') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::ARROW, "->"));
+                    return makeToken(TokenType::ARROW);
                 } else {
-                    tokens.push_back(makeToken(TokenType::MINUS, "-"));
+                    return makeToken(TokenType::MINUS);
                 }
-                break;
             
             case '=':
                 advance();
                 if (peek() == '=') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::EQUAL, "=="));
+                    return makeToken(TokenType::EQUAL);
                 } else {
-                    tokens.push_back(makeToken(TokenType::ASSIGN, "="));
+                    return makeToken(TokenType::ASSIGN);
                 }
-                break;
             
             case '!':
                 advance();
                 if (peek() == '=') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::NOT_EQUAL, "!="));
+                    return makeToken(TokenType::NOT_EQUAL);
                 } else {
-                    tokens.push_back(makeToken(TokenType::NOT, "!"));
+                    return makeToken(TokenType::NOT);
                 }
-                break;
             
             case '<':
                 advance();
                 if (peek() == '=') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::LESS_EQUAL, "<="));
+                    return makeToken(TokenType::LESS_EQUAL);
                 } else if (peek() == '<') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::SHIFT_LEFT, "<<"));
+                    return makeToken(TokenType::SHIFT_LEFT);
                 } else {
-                    tokens.push_back(makeToken(TokenType::LESS, "<"));
+                    return makeToken(TokenType::LESS);
                 }
-                break;
             
             case '>':
                 advance();
                 if (peek() == '=') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::GREATER_EQUAL, ">="));
+                    return makeToken(TokenType::GREATER_EQUAL);
                 } else if (peek() == '>') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::SHIFT_RIGHT, ">>"));
+                    return makeToken(TokenType::SHIFT_RIGHT);
                 } else {
-                    tokens.push_back(makeToken(TokenType::GREATER, ">"));
+                    return makeToken(TokenType::GREATER);
                 }
-                break;
             
             case '&':
                 advance();
                 if (peek() == '&') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::AND, "&&"));
+                    return makeToken(TokenType::AND);
                 } else {
-                    tokens.push_back(makeToken(TokenType::BITWISE_AND, "&"));
+                    return makeToken(TokenType::BITWISE_AND);
                 }
-                break;
             
             case '|':
                 advance();
                 if (peek() == '|') {
                     advance();
-                    tokens.push_back(makeToken(TokenType::OR, "||"));
+                    return makeToken(TokenType::OR);
                 } else {
-                    tokens.push_back(makeToken(TokenType::BITWISE_OR, "|"));
+                    return makeToken(TokenType::BITWISE_OR);
                 }
-                break;
             
             case '^':
-                tokens.push_back(makeToken(TokenType::BITWISE_XOR, std::string(1, advance())));
-                break;
+                advance();
+                return makeToken(TokenType::BITWISE_XOR);
             
             case '/':
                 advance();
                 if (peek() == '/') {
                     skipComment();
-                } else {
-                    tokens.push_back(makeToken(TokenType::DIVIDE, "/"));
+                    continue;
                 }
-                break;
+                return makeToken(TokenType::DIVIDE);
             
             default:
-                tokens.push_back(makeToken(TokenType::INVALID, std::string(1, advance())));
-                break;
+                advance();
+                return makeToken(TokenType::INVALID);
         }
     }
     
-    // Add dedent tokens for any remaining indentation
-    while (indentStack.size() > 1) {
+    // Close any remaining indentation, one DEDENT per call. Once these are
+    // exhausted every further call returns END_OF_FILE.
+    beginToken();
+    if (indentStack.size() > 1) {
         indentStack.pop_back();
-        tokens.push_back(makeToken(TokenType::DEDENT, ""));
+        return makeToken(TokenType::DEDENT);
     }
     
-    tokens.push_back(makeToken(TokenType::END_OF_FILE, ""));
-    return tokens;
+    return makeToken(TokenType::END_OF_FILE);
 }
 
 char Lexer::peek(int offset) const {
@@ -248,105 +397,123 @@ char Lexer::advance() {
     return c;
 }
 
+void Lexer::skipTo(size_t end) {
+    column += static_cast<int>(end - pos);
+    pos = end;
+}
+
 void Lexer::skipWhitespace() {
-    while (peek() == ' ' || peek() == '\t') {
-        advance();
-    }
+    skipTo(scanWhile<Blanks>(source, pos));
 }
 
 void Lexer::skipComment() {
     if (peek() == '#') {
-        while (peek() != '\n' && peek() != '\r' && !isAtEnd()) {
-            advance();
-        }
+        skipTo(scanWhile<LineChars>(source, pos));
     }
 }
 
-Token Lexer::makeToken(TokenType type, const std::string& value) {
-    return Token(type, value, line, column - value.length());
+void Lexer::beginToken() {
+    tokenStart = pos;
+    tokenLine = line;
+    tokenColumn = column;
+}
+
+Token Lexer::makeToken(TokenType type) {
+    return makeToken(type, source.substr(tokenStart, pos - tokenStart));
+}
+
+Token Lexer::makeToken(TokenType type, std::string_view value) {
+    return Token(type, value, tokenLine, tokenColumn);
 }
 
 Token Lexer::readNumber() {
-    std::string num;
     bool isFloat = false;
     
-    while (isDigit(peek())) {
-        num += advance();
-    }
+    skipTo(scanWhile<Digits>(source, pos));
     
     if (peek() == '.' && isDigit(peek(1))) {
         isFloat = true;
-        num += advance(); // consume '.'
-        while (isDigit(peek())) {
-            num += advance();
-        }
+        advance(); // consume '.'
+        skipTo(scanWhile<Digits>(source, pos));
     }
     
-    return makeToken(isFloat ? TokenType::FLOAT : TokenType::INTEGER, num);
+    return makeToken(isFloat ? TokenType::FLOAT : TokenType::INTEGER);
 }
 
 Token Lexer::readString() {
     char quote = advance(); // consume opening quote
-    std::string str;
+    size_t start = pos;
     
     while (peek() != quote && !isAtEnd()) {
         if (peek() == '\\') {
             advance();
-            char escaped = advance();
-            switch (escaped) {
-                case 'n': str += '\n'; break;
-                case 't': str += '\t'; break;
-                case 'r': str += '\r'; break;
-                case '\\': str += '\\'; break;
-                case '"': str += '"'; break;
-                case '\'': str += '\''; break;
-                default: str += escaped; break;
-            }
-        } else {
-            str += advance();
+        }
+        if (!isAtEnd()) {
+            advance();
         }
     }
     
+    std::string_view text = source.substr(start, pos - start);
     if (isAtEnd()) {
-        return makeToken(TokenType::INVALID, str);
+        return makeToken(TokenType::INVALID, text);
     }
     
     advance(); // consume closing quote
-    return makeToken(TokenType::STRING, str);
+    return makeToken(TokenType::STRING, text);
 }
 
-Token Lexer::readIdentifier() {
-    std::string id;
+std::string Lexer::unescape(std::string_view text) {
+    std::string str;
+    str.reserve(text.size());
     
-    while (isAlphaNumeric(peek()) || peek() == '_') {
-        id += advance();
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            str += text[i];
+            continue;
+        }
+        char escaped = text[++i];
+        switch (escaped) {
+            case 'n': str += '\n'; break;
+            case 't': str += '\t'; break;
+            case 'r': str += '\r'; break;
+            case '\\': str += '\\'; break;
+            case '"': str += '"'; break;
+            case '\'': str += '\''; break;
+            default: str += escaped; break;
+        }
     }
     
-    auto it = keywords.find(id);
-    TokenType type = (it != keywords.end()) ? it->second : TokenType::IDENTIFIER;
-    
-    return makeToken(type, id);
+    return str;
 }
 
-std::vector<Token> Lexer::handleIndentation(int spaces) {
-    std::vector<Token> tokens;
+Token Lexer::readIdentifier() {
+    skipTo(scanWhile<IdentifierChars>(source, pos));
     
+    Token token = makeToken(TokenType::IDENTIFIER);
+    token.type = lookupKeyword(token.value);
+    if (token.type == TokenType::IDENTIFIER) {
+        token.id = identifiers.intern(token.value);
+    }
+    return token;
+}
+
+void Lexer::handleIndentation(int spaces) {
+    // Only records what changed; next() hands the queued INDENT/DEDENT
+    // tokens out one per call
     if (spaces > indentStack.back()) {
         indentStack.push_back(spaces);
-        tokens.push_back(makeToken(TokenType::INDENT, ""));
+        pendingIndent = true;
     } else if (spaces < indentStack.back()) {
         while (!indentStack.empty() && spaces < indentStack.back()) {
             indentStack.pop_back();
-            tokens.push_back(makeToken(TokenType::DEDENT, ""));
+            pendingDedents++;
         }
         
         if (indentStack.empty() || spaces != indentStack.back()) {
             // Indentation error - not matching any previous level
-            tokens.push_back(makeToken(TokenType::INVALID, ""));
+            pendingIndentError = true;
         }
     }
-    
-    return tokens;
 }
 
 bool Lexer::isAtEnd() const {
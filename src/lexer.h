@@ -1,9 +1,10 @@
 #ifndef HASH_LEXER_H
 #define HASH_LEXER_H
 
+#include "identifiers.h"
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
 
 namespace hash {
 
@@ -67,41 +68,76 @@ enum class TokenType {
     INVALID
 };
 
+// A token is a view into the source text, so lexing allocates nothing per
+// token. The source must stay alive, and unmoved, while tokens are in use.
+// STRING tokens view the text between the quotes with escapes still in
+// place; Lexer::unescape turns them into the string's value.
+// IDENTIFIER tokens also carry the identifier's interned id.
 struct Token {
     TokenType type;
-    std::string value;
+    IdentifierId id;
+    std::string_view value;
     int line;
     int column;
     
-    Token(TokenType t, const std::string& v, int l, int c)
-        : type(t), value(v), line(l), column(c) {}
+    Token() : type(TokenType::END_OF_FILE), id(NoIdentifier), line(0), column(0) {}
+    Token(TokenType t, std::string_view v, int l, int c)
+        : type(t), id(NoIdentifier), value(v), line(l), column(c) {}
 };
 
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    // Does not copy the source; see Token. Identifiers are interned into
+    // identifiers, which must outlive the lexer. A source cut from a larger
+    // file numbers its lines from firstLine.
+    Lexer(std::string_view source, IdentifierTable& identifiers, int firstLine = 1);
+    
+    // Scans and returns the next token. After the last token every call
+    // returns END_OF_FILE.
+    Token next();
+    // All remaining tokens, ending with END_OF_FILE
     std::vector<Token> tokenize();
     
+    IdentifierTable& getIdentifiers() const { return identifiers; }
+    
+    // The value of a STRING token
+    static std::string unescape(std::string_view text);
+    
 private:
-    std::string source;
+    std::string_view source;
+    IdentifierTable& identifiers;
     size_t pos;
     int line;
     int column;
     int currentIndent;
     std::vector<int> indentStack;
+    bool atLineStart;
+    
+    // Indentation tokens still owed by next(), in this order
+    bool pendingIndent;
+    int pendingDedents;
+    bool pendingIndentError;
     
-    static std::unordered_map<std::string, TokenType> keywords;
+    // Where the token being scanned starts
+    size_t tokenStart;
+    int tokenLine;
+    int tokenColumn;
     
     char peek(int offset = 0) const;
     char advance();
+    // Moves to end, which must not be past a newline
+    void skipTo(size_t end);
     void skipWhitespace();
     void skipComment();
     
-    Token makeToken(TokenType type, const std::string& value);
+    void beginToken();
+    // A token spanning from beginToken() to the current position
+    Token makeToken(TokenType type);
+    Token makeToken(TokenType type, std::string_view value);
     Token readNumber();
     Token readString();
     Token readIdentifier();
-    std::vector<Token> handleIndentation(int spaces);
+    void handleIndentation(int spaces);
     
     bool isAtEnd() const;
     bool isDigit(char c) const;
@@ -0,0 +1,360 @@
+#include "linker.h"
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Triple.h>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+#ifdef HASH_HAVE_LLD
+#include <lld/Common/Driver.h>
+LLD_HAS_DRIVER(elf)
+#endif
+
+#ifndef HASH_RUNTIME_LIBRARY_NAME
+#ifdef _WIN32
+#define HASH_RUNTIME_LIBRARY_NAME "hashrt.lib"
+#else
+#define HASH_RUNTIME_LIBRARY_NAME "libhashrt.a"
+#endif
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace hash {
+
+#ifdef HASH_HAVE_LLD
+// lld keeps global state and can only run one link at a time per process,
+// so batch compiles that link from several threads take turns
+static std::mutex lldMutex;
+#endif
+
+Linker::Linker(const std::string& targetTriple)
+    : targetTriple(targetTriple) {}
+
+bool Linker::isInProcess() const {
+#if defined(HASH_HAVE_LLD) && defined(__linux__)
+    llvm::Triple triple(targetTriple);
+    return triple.isOSLinux() && triple.isOSBinFormatELF();
+#else
+    return false;
+#endif
+}
+
+bool Linker::link(llvm::ArrayRef<char> object, const std::string& outputFile) {
+    return link(std::vector<llvm::ArrayRef<char>>{object}, outputFile);
+}
+
+bool Linker::link(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile) {
+    error.clear();
+    runtimeLibrary.clear();
+    if (needsRuntime(objects)) {
+        runtimeLibrary = getRuntimeLibrary();
+        if (runtimeLibrary.empty()) {
+            error = "The program calls libhashrt, but no " HASH_RUNTIME_LIBRARY_NAME " for target "
+                    + targetTriple + " was found. Looked in:";
+            for (const auto& dir : getRuntimeDirectories()) {
+                error += "\n  " + dir;
+            }
+            return false;
+        }
+    }
+    if (isInProcess()) {
+        return linkInProcess(objects, outputFile);
+    }
+    return linkWithDriver(objects, outputFile);
+}
+
+bool Linker::linkInProcess(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile) {
+#if defined(HASH_HAVE_LLD) && defined(__linux__)
+    std::string crtDir = findCRTDirectory();
+    if (crtDir.empty()) {
+        error = "Could not find the C runtime startup files (crt1.o)";
+        return false;
+    }
+
+    std::string dynamicLinker = getDynamicLinker();
+    if (dynamicLinker.empty()) {
+        error = "No known dynamic linker for target " + targetTriple;
+        return false;
+    }
+
+    std::vector<std::string> args = {
+        "ld.lld",
+        "--eh-frame-hdr",
+        "-o", outputFile,
+        "-dynamic-linker", dynamicLinker,
+        crtDir + "/crt1.o",
+        crtDir + "/crti.o",
+    };
+
+    // Hand each object to lld through an anonymous in-memory file rather
+    // than writing a temporary .o to disk
+    std::vector<int> fds;
+    auto closeAll = [&fds]() {
+        for (int fd : fds) {
+            close(fd);
+        }
+    };
+    for (const auto& object : objects) {
+        int fd = memfd_create("hash-object", MFD_CLOEXEC);
+        if (fd < 0) {
+            closeAll();
+            error = "Could not create in-memory object file";
+            return false;
+        }
+        fds.push_back(fd);
+
+        const char* data = object.data();
+        size_t remaining = object.size();
+        while (remaining > 0) {
+            ssize_t written = write(fd, data, remaining);
+            if (written <= 0) {
+                closeAll();
+                error = "Could not write in-memory object file";
+                return false;
+            }
+            data += written;
+            remaining -= written;
+        }
+        args.push_back("/proc/self/fd/" + std::to_string(fd));
+    }
+
+    for (const auto& dir : getLibraryDirectories()) {
+        args.push_back("-L" + dir);
+    }
+    // Runtime calls that were not inlined from bitcode come from libhashrt
+    if (!runtimeLibrary.empty()) {
+        args.push_back(runtimeLibrary);
+    }
+    if (profileRuntime) {
+#ifdef HASH_PROFILE_RUNTIME
+        // Nothing in the instrumented code references the runtime's
+        // registration hook on Linux, so it has to be pulled in explicitly
+        args.push_back("-u__llvm_profile_runtime");
+        args.push_back(HASH_PROFILE_RUNTIME);
+#else
+        closeAll();
+        error = "hashc was built without the compiler-rt profile runtime";
+        return false;
+#endif
+    }
+    // Beyond that, Hash programs only need libc and libm (sin, pow, ... from intrinsics)
+    args.push_back("-lm");
+    args.push_back("-lc");
+    args.push_back(crtDir + "/crtn.o");
+
+    std::vector<const char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(arg.c_str());
+    }
+
+    std::string diagnostics;
+    llvm::raw_string_ostream diagnosticStream(diagnostics);
+    lld::Result result;
+    {
+        std::lock_guard<std::mutex> lock(lldMutex);
+        result = lld::lldMain(argv, llvm::outs(), diagnosticStream,
+                              {{lld::Gnu, &lld::elf::link}});
+    }
+    closeAll();
+
+    if (result.retCode != 0) {
+        error = diagnosticStream.str();
+        return false;
+    }
+    return true;
+#else
+    error = "hashc was built without in-process linking support";
+    return false;
+#endif
+}
+
+bool Linker::linkWithDriver(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile) {
+    std::vector<std::string> objFiles;
+    auto removeAll = [&objFiles]() {
+        for (const auto& objFile : objFiles) {
+            std::filesystem::remove(objFile);
+        }
+    };
+    for (size_t i = 0; i < objects.size(); i++) {
+        std::string objFile = objects.size() == 1 ? outputFile + ".o"
+                                                  : outputFile + "." + std::to_string(i) + ".o";
+        std::error_code EC;
+        llvm::raw_fd_ostream dest(objFile, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            removeAll();
+            error = "Could not open file: " + EC.message();
+            return false;
+        }
+        objFiles.push_back(objFile);
+        dest.write(objects[i].data(), objects[i].size());
+        dest.close();
+    }
+
+    // Hash code only needs the C runtime (libhashrt is C++ built without
+    // exceptions or RTTI), so use the C driver rather than clang++ and
+    // avoid pulling in the C++ standard library
+    std::string linkCmd = "clang";
+    for (const auto& objFile : objFiles) {
+        linkCmd += " " + objFile;
+    }
+    if (!runtimeLibrary.empty()) {
+        linkCmd += " \"" + runtimeLibrary + "\"";
+    }
+    if (profileRuntime) {
+        // Makes the driver link its profile runtime
+        linkCmd += " -fprofile-instr-generate";
+    }
+    #ifdef _WIN32
+    linkCmd += " -o " + outputFile + " -llegacy_stdio_definitions";
+    #else
+    linkCmd += " -o " + outputFile + " -lm";
+    #endif
+    int result = system(linkCmd.c_str());
+
+    removeAll();
+
+    if (result != 0) {
+        error = "Linker command failed: " + linkCmd;
+        return false;
+    }
+    return true;
+}
+
+bool Linker::needsRuntime(const std::vector<llvm::ArrayRef<char>>& objects) const {
+    for (const auto& object : objects) {
+        llvm::MemoryBufferRef buffer(llvm::StringRef(object.data(), object.size()), "object");
+        auto file = llvm::object::ObjectFile::createObjectFile(buffer);
+        if (!file) {
+            // Cannot tell, so link the runtime if there is one
+            llvm::consumeError(file.takeError());
+            return true;
+        }
+        for (const llvm::object::SymbolRef& symbol : (*file)->symbols()) {
+            auto flags = symbol.getFlags();
+            if (!flags) {
+                llvm::consumeError(flags.takeError());
+                continue;
+            }
+            if (!(*flags & llvm::object::SymbolRef::SF_Undefined)) {
+                continue;
+            }
+            auto name = symbol.getName();
+            if (!name) {
+                llvm::consumeError(name.takeError());
+                continue;
+            }
+            // Mach-O and 32-bit Windows prefix C symbols with an underscore
+            llvm::StringRef symbolName = *name;
+            symbolName.consume_front("_");
+            if (symbolName.starts_with("hashrt_")) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Anchors getMainExecutable on platforms that find the executable through
+// the address of one of its functions
+static void mainExecutableAnchor() {}
+
+std::vector<std::string> Linker::getRuntimeDirectories() const {
+    std::vector<std::string> dirs;
+    std::string executable = llvm::sys::fs::getMainExecutable(
+        nullptr, reinterpret_cast<void*>(&mainExecutableAnchor));
+    llvm::SmallString<128> libDir;
+    if (!executable.empty()) {
+        libDir = llvm::sys::path::parent_path(llvm::sys::path::parent_path(executable));
+        llvm::sys::path::append(libDir, "lib");
+    }
+    
+    // A libhashrt built for the target goes in lib/<target triple>
+    if (!libDir.empty()) {
+        llvm::SmallString<128> targetDir(libDir);
+        llvm::sys::path::append(targetDir, llvm::Triple::normalize(targetTriple));
+        dirs.push_back(std::string(targetDir));
+    }
+    
+    // The one installed in lib, or built next to hashc, is for the host
+    llvm::Triple target(targetTriple);
+    llvm::Triple host(LLVM_HOST_TRIPLE);
+    if (target.getArch() == host.getArch() && target.getOS() == host.getOS()) {
+        if (!libDir.empty()) {
+            dirs.push_back(std::string(libDir));
+        }
+#ifdef HASH_RUNTIME_BUILD_DIR
+        dirs.push_back(HASH_RUNTIME_BUILD_DIR);
+#endif
+    }
+    return dirs;
+}
+
+std::string Linker::getRuntimeLibrary() const {
+    for (const auto& dir : getRuntimeDirectories()) {
+        llvm::SmallString<128> path(dir);
+        llvm::sys::path::append(path, HASH_RUNTIME_LIBRARY_NAME);
+        if (llvm::sys::fs::exists(path)) {
+            return std::string(path);
+        }
+    }
+    return "";
+}
+
+std::string Linker::findCRTDirectory() const {
+    for (const auto& dir : getLibraryDirectories()) {
+        if (llvm::sys::fs::exists(dir + "/crt1.o")) {
+            return dir;
+        }
+    }
+    return "";
+}
+
+std::string Linker::getDynamicLinker() const {
+    switch (llvm::Triple(targetTriple).getArch()) {
+        case llvm::Triple::x86_64: return "/lib64/ld-linux-x86-64.so.2";
+        case llvm::Triple::x86: return "/lib/ld-linux.so.2";
+        case llvm::Triple::aarch64: return "/lib/ld-linux-aarch64.so.1";
+        case llvm::Triple::arm: return "/lib/ld-linux-armhf.so.3";
+        case llvm::Triple::riscv64: return "/lib/ld-linux-riscv64-lp64d.so.1";
+        default: return "";
+    }
+}
+
+std::vector<std::string> Linker::getLibraryDirectories() const {
+    // Debian-style multiarch directories first, then the traditional ones
+    llvm::Triple triple(targetTriple);
+    std::string multiarch;
+    switch (triple.getArch()) {
+        case llvm::Triple::x86: multiarch = "i386-linux-gnu"; break;
+        case llvm::Triple::arm: multiarch = "arm-linux-gnueabihf"; break;
+        default: multiarch = triple.getArchName().str() + "-linux-gnu"; break;
+    }
+
+    std::vector<std::string> candidates = {
+        "/lib/" + multiarch,
+        "/usr/lib/" + multiarch,
+        "/lib64",
+        "/usr/lib64",
+        "/lib",
+        "/usr/lib",
+    };
+
+    std::vector<std::string> dirs;
+    for (const auto& dir : candidates) {
+        if (llvm::sys::fs::is_directory(dir)) {
+            dirs.push_back(dir);
+        }
+    }
+    return dirs;
+}
+
+} // namespace hash
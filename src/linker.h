@@ -0,0 +1,61 @@
+#ifndef HASH_LINKER_H
+#define HASH_LINKER_H
+
+#include <llvm/ADT/ArrayRef.h>
+#include <string>
+#include <vector>
+
+namespace hash {
+
+// Turns the objects produced by CodeGenerator into an executable.
+//
+// When hashc is built against the LLD library (HASH_HAVE_LLD) and the
+// target is ELF, the in-memory objects are linked against libc in-process:
+// no temporary object files and no compiler driver subprocess. Everywhere
+// else the objects are written next to the output and linked with the
+// system C compiler driver.
+class Linker {
+public:
+    Linker(const std::string& targetTriple);
+
+    bool link(llvm::ArrayRef<char> object, const std::string& outputFile);
+    // Links several objects, e.g. the partitions from parallel codegen
+    bool link(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile);
+
+    // Link the compiler-rt profile runtime that writes .profraw files, for
+    // programs built with --profile-generate
+    void setProfileRuntime(bool enabled) { profileRuntime = enabled; }
+
+    // True if link() will run without spawning a process or touching disk
+    bool isInProcess() const;
+
+    const std::string& getError() const { return error; }
+
+    // Path of the libhashrt static library for the target, or empty if
+    // there is none
+    std::string getRuntimeLibrary() const;
+
+private:
+    std::string targetTriple;
+    std::string error;
+    bool profileRuntime = false;
+    // libhashrt for the current link, empty if the objects do not need it
+    std::string runtimeLibrary;
+
+    bool linkInProcess(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile);
+    bool linkWithDriver(const std::vector<llvm::ArrayRef<char>>& objects, const std::string& outputFile);
+
+    // True if an object calls a libhashrt function the bitcode runtime did
+    // not inline, e.g. because the target is not the host
+    bool needsRuntime(const std::vector<llvm::ArrayRef<char>>& objects) const;
+    // Where libhashrt is looked for: lib/<target triple> next to hashc's
+    // bin directory, then, for host targets, lib itself and the build tree
+    std::vector<std::string> getRuntimeDirectories() const;
+    std::string findCRTDirectory() const;
+    std::string getDynamicLinker() const;
+    std::vector<std::string> getLibraryDirectories() const;
+};
+
+} // namespace hash
+
+#endif // HASH_LINKER_H
@@ -3,17 +3,36 @@
 #include "semantic.h"
 #include "codegen.h"
 #include "error_reporter.h"
+#include "linker.h"
+#include "cache.h"
+#include "incremental.h"
+#include "modules.h"
+#include "source_manager.h"
+#include <llvm/Config/llvm-config.h>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 
+// Where the driver's messages go. Batch compilation points these at
+// per-file buffers so messages of files compiled at once don't interleave.
+static thread_local std::ostream* statusOut = &std::cout;
+static thread_local std::ostream* errorOut = &std::cerr;
+
 std::string readFile(const std::string& filename) {
     std::ifstream file(filename);
     if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << filename << "'" << std::endl;
+        *errorOut << "Error: Could not open file '" << filename << "'" << std::endl;
         return "";
     }
     
@@ -23,147 +42,511 @@ std::string readFile(const std::string& filename) {
 }
 
 void printError(const std::string& message, const std::string& filename = "") {
-    std::cerr << "\033[1;31mError:\033[0m ";
+    *errorOut << "\033[1;31mError:\033[0m ";
     if (!filename.empty()) {
-        std::cerr << filename << ": ";
+        *errorOut << filename << ": ";
     }
-    std::cerr << message << std::endl;
+    *errorOut << message << std::endl;
 }
 
 void printWarning(const std::string& message, const std::string& filename = "") {
-    std::cerr << "\033[1;33mWarning:\033[0m ";
+    *errorOut << "\033[1;33mWarning:\033[0m ";
     if (!filename.empty()) {
-        std::cerr << filename << ": ";
+        *errorOut << filename << ": ";
     }
-    std::cerr << message << std::endl;
+    *errorOut << message << std::endl;
+}
+
+// Set by 'run'/--jit so compiler progress doesn't mix with program output
+static bool quiet = false;
+
+void printStatus(const std::string& message) {
+    if (quiet) return;
+    *statusOut << message << std::endl;
 }
 
 void printSuccess(const std::string& message) {
-    std::cout << "\033[1;32m!\033[0m " << message << std::endl;
+    if (quiet) return;
+    *statusOut << "\033[1;32m!\033[0m " << message << std::endl;
 }
 
+// Runs work(i) for every module of the program, each on its own thread
+void forEachModule(size_t count, const std::function<void(size_t)>& work) {
+    if (count == 1) {
+        work(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < count; i++) {
+        workers.emplace_back(work, i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Command-line settings shared by every program compiled in this run
+struct CompileOptions {
+    bool emitLLVM = false;
+    bool emitIR = false;
+    bool printAST = false;
+    bool printTokens = false;
+    bool benchLexer = false;
+    bool runJIT = false;
+    hash::OptLevel optLevel = hash::OptLevel::O0;
+    std::string targetTriple;
+    std::string targetCPU;
+    std::string targetFeatures;
+    unsigned codegenThreads = 1;
+    // Threads parsing and semantic analysis of one program may use, 0 for
+    // all cores. Batch compilations set it to 1, since each file has its
+    // own worker.
+    unsigned frontendThreads = 0;
+    bool profileGenerate = false;
+    std::string rawProfileFile; // Empty for <input>.profraw
+    std::string profileUseFile;
+    std::string profileUseKey; // Hash of the --profile-use file's contents
+    bool useCache = false;
+    hash::CompilationCache* cache = nullptr; // Not owned; set for --cache and --cache-stats
+    bool printCacheStats = false;
+    bool incremental = false;
+    std::string incrementalDir = ".hashc-incremental";
+};
+
 void printUsage(const char* programName) {
     std::cout << "Hash Language Compiler\n";
-    std::cout << "Usage: " << programName << " [options] <input.hash>\n\n";
+    std::cout << "Usage: " << programName << " [options] <input.hash>...\n";
+    std::cout << "       " << programName << " run [options] <input.hash>...\n\n";
+    std::cout << "Several input files are compiled in parallel, each to an executable\n";
+    std::cout << "named after it. With -o or 'run' they form one program instead.\n";
+    std::cout << "An input of - reads the program from stdin.\n\n";
     std::cout << "Options:\n";
     std::cout << "  -o <output>     Specify output file (default: a.out)\n";
     std::cout << "  --emit-llvm     Emit LLVM IR instead of object file\n";
     std::cout << "  --emit-ir       Save LLVM IR to file (.ll)\n";
+    std::cout << "  --jit           Run the program in-process instead of writing an\n";
+    std::cout << "                  executable (same as 'run')\n";
+    std::cout << "  -O<level>       Optimization level: 0, 1, 2, 3, s, z (default: 0)\n";
+    std::cout << "  --target=<triple>\n";
+    std::cout << "                  Cross-compile for another target, e.g.\n";
+    std::cout << "                  aarch64-linux-gnu (default: the host)\n";
+    std::cout << "  --target-cpu=<cpu>\n";
+    std::cout << "                  CPU to generate code for, or 'native' (default: native\n";
+    std::cout << "                  when optimizing for the host, generic otherwise)\n";
+    std::cout << "  --target-features=<+feat,-feat>\n";
+    std::cout << "                  Enable/disable CPU features, e.g. +avx2,-avx512f\n";
+    std::cout << "  --profile-generate[=<file>]\n";
+    std::cout << "                  Instrument the program to record an execution profile\n";
+    std::cout << "                  (default file: <input>.profraw)\n";
+    std::cout << "  --profile-use=<file>\n";
+    std::cout << "                  Optimize using a profile merged with llvm-profdata\n";
+    std::cout << "  -j <n>, --codegen-threads=<n>\n";
+    std::cout << "                  Generate machine code on n threads, 0 for all cores\n";
+    std::cout << "                  (default: 1)\n";
+    std::cout << "  --jobs=<n>      Compile up to n input files at once (default: all cores)\n";
+    std::cout << "  --cache         Reuse outputs of identical earlier compilations\n";
+    std::cout << "  --cache-dir=<dir>\n";
+    std::cout << "                  Cache directory, implies --cache (default: user cache\n";
+    std::cout << "                  directory, or $HASH_CACHE_DIR which also enables it)\n";
+    std::cout << "  --cache-size=<MB>\n";
+    std::cout << "                  Evict least recently used entries beyond this size\n";
+    std::cout << "                  (default: 1024)\n";
+    std::cout << "  --cache-stats   Print cache hit/miss statistics\n";
+    std::cout << "  --incremental   Only regenerate functions that changed since the last\n";
+    std::cout << "                  build and reuse stored machine code for the rest\n";
+    std::cout << "  --incremental-dir=<dir>\n";
+    std::cout << "                  Store for --incremental, implies it\n";
+    std::cout << "                  (default: .hashc-incremental)\n";
     std::cout << "  --ast           Print AST and exit\n";
     std::cout << "  --tokens        Print tokens and exit\n";
+    std::cout << "  --bench-lexer   Report lexer throughput in MB/s and exit\n";
+    std::cout << "  --bench-parser  Time parsing of a generated stress corpus (deep nesting,\n";
+    std::cout << "                  long operator chains, long functions) and exit\n";
+    std::cout << "  --bench-semantic\n";
+    std::cout << "                  Time semantic analysis of a generated 10,000-function\n";
+    std::cout << "                  program on 1, 2, 4, ... threads and exit\n";
     std::cout << "  -h, --help      Show this help message\n";
     std::cout << "\nExamples:\n";
     std::cout << "  " << programName << " program.hash\n";
     std::cout << "  " << programName << " -o program program.hash\n";
+    std::cout << "  " << programName << " -O2 -o program program.hash\n";
     std::cout << "  " << programName << " --emit-llvm program.hash\n";
+    std::cout << "  " << programName << " run program.hash\n";
+    std::cout << "  " << programName << " -O2 scripts/*.hash\n";
 }
 
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        printUsage(argv[0]);
-        return 1;
-    }
+// Lexes source over and over for about a second and reports throughput
+void benchmarkLexer(std::string_view source) {
+    using Clock = std::chrono::steady_clock;
+    size_t passes = 0;
+    size_t tokens = 0;
+    auto start = Clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do {
+        hash::IdentifierTable identifiers;
+        hash::Lexer lexer(source, identifiers);
+        while (lexer.next().type != hash::TokenType::END_OF_FILE) {
+            tokens++;
+        }
+        passes++;
+        elapsed = Clock::now() - start;
+    } while (elapsed.count() < 1.0);
     
-    std::string inputFile;
-    #ifdef _WIN32
-    std::string outputFile = "a.exe";
-    #else
-    std::string outputFile = "a.out";
-    #endif
-    bool emitLLVM = false;
-    bool emitIR = false;
-    bool printAST = false;
-    bool printTokens = false;
+    double megabytes = static_cast<double>(source.size()) * passes / (1024.0 * 1024.0);
+    *statusOut << "Lexed " << source.size() << " bytes " << passes << " times in "
+               << elapsed.count() << "s: " << megabytes / elapsed.count() << " MB/s, "
+               << tokens / elapsed.count() / 1e6 << " million tokens/s" << std::endl;
+}
+
+// Parses each case of a generated stress corpus repeatedly for about half a
+// second and reports throughput and the memory its AST takes, so parser
+// scaling on machine-generated code can be tracked. Cases with a thread
+// count go through the whole-file parser, which splits them into chunks.
+int benchmarkParser() {
+    using Clock = std::chrono::steady_clock;
+    const int depth = 100000;
+    auto repeat = [](const std::string& text, int count) {
+        std::string result;
+        result.reserve(text.size() * count);
+        for (int i = 0; i < count; i++) {
+            result += text;
+        }
+        return result;
+    };
     
-    // Parse command line arguments
-    for (int i = 1; i < argc; i++) {
-        std::string arg = argv[i];
-        
-        if (arg == "-h" || arg == "--help") {
-            printUsage(argv[0]);
-            return 0;
-        } else if (arg == "-o") {
-            if (i + 1 < argc) {
-                outputFile = argv[++i];
+    struct Case {
+        std::string name;
+        std::string source;
+        unsigned threads = 0; // 0: one Lexer over the whole source
+    };
+    std::vector<Case> corpus;
+    corpus.push_back({"nested parentheses",
+                      "let x: i32 = " + repeat("(", depth) + "1" + repeat(")", depth) + "\n"});
+    corpus.push_back({"nested calls",
+                      "let x: i32 = " + repeat("abs(", depth) + "1" + repeat(")", depth) + "\n"});
+    corpus.push_back({"unary chain", "let x: i32 = " + repeat("-", depth) + "1\n"});
+    std::string chain = "let x: i32 = 1";
+    for (int i = 0; i < 2 * depth; i++) {
+        chain += i % 3 == 0 ? " + y * " : i % 3 == 1 ? " - " : " << ";
+        chain += std::to_string(i % 100);
+    }
+    corpus.push_back({"long binary chain", chain + "\n"});
+    std::string function = "fn long() -> i32:\n    let mut total: i32 = 0\n";
+    for (int i = 0; i < depth / 2; i++) {
+        std::string n = std::to_string(i);
+        function += "    let v" + n + ": i32 = total * " + n + " + (total - 1) / 2\n"
+                    "    if v" + n + " > 10:\n"
+                    "        total = total + abs(v" + n + " % 7)\n";
+    }
+    corpus.push_back({"long function", function + "    return total\n"});
+    std::string functions;
+    for (int i = 0; i < depth / 10; i++) {
+        std::string n = std::to_string(i);
+        functions += "fn work" + n + "(a: i32, b: i32) -> i32:\n"
+                     "    let mut i: i32 = 0\n"
+                     "    while i < b:\n"
+                     "        i = i + max(a, i * 2) - (a << 1)\n"
+                     "    return i\n";
+    }
+    corpus.push_back({"many functions", functions});
+    std::string chained = "fn main() -> i32:\n    let a: i32 = 1\n    return " + repeat("a + ", 2 * depth) + "1\n";
+    corpus.push_back({"long chain between functions, 4 threads", functions + chained + functions, 4});
+    
+    for (const auto& [name, source, threads] : corpus) {
+        size_t passes = 0;
+        size_t astBytes = 0;
+        auto start = Clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do {
+            hash::IdentifierTable identifiers;
+            std::shared_ptr<hash::Program> program;
+            std::vector<std::string> errors;
+            if (threads == 0) {
+                hash::Lexer lexer(source, identifiers);
+                hash::Parser parser(lexer);
+                program = parser.parse();
+                errors = parser.getErrors();
             } else {
-                printError("Expected output file after -o");
+                hash::Parser parser(source, identifiers);
+                parser.setThreads(threads);
+                program = parser.parse();
+                errors = parser.getErrors();
+            }
+            if (!errors.empty()) {
+                printError("Benchmark case '" + name + "' failed to parse: " + errors[0]);
                 return 1;
             }
-        } else if (arg == "--emit-llvm") {
-            emitLLVM = true;
-        } else if (arg == "--emit-ir") {
-            emitIR = true;
-        } else if (arg == "--ast") {
-            printAST = true;
-        } else if (arg == "--tokens") {
-            printTokens = true;
-        } else if (arg[0] == '-') {
-            printError("Unknown option: " + arg);
-            return 1;
-        } else {
-            inputFile = arg;
-        }
+            astBytes = program->context.getBytesAllocated();
+            passes++;
+            elapsed = Clock::now() - start;
+        } while (elapsed.count() < 0.5);
+        
+        double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+        *statusOut << "  " << name << ": " << megabytes << " MB in " << elapsed.count() * 1000 / passes
+                   << " ms, " << megabytes * passes / elapsed.count() << " MB/s, AST "
+                   << astBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+    return 0;
+}
+
+// Generates a program of 10,000 functions, half of them pure, and analyzes it
+// on 1, 2, 4, ... threads up to the number of cores to show how analysis of
+// function bodies scales
+int benchmarkSemantic() {
+    using Clock = std::chrono::steady_clock;
+    const int pairs = 5000;
+    std::string source = "let scale: i32 = 3\n";
+    for (int i = 0; i < pairs; i++) {
+        std::string n = std::to_string(i);
+        std::string callee = i > 0 ? "func" + std::to_string(i - 1) + "(i, scale)" : "i";
+        source += "pure fn pure" + n + "(x: i32, y: f64) -> i32:\n"
+                  "    let scaled: f64 = sqrt(y) * 2.0 + floor(y)\n"
+                  "    return x * " + n + " + int(scaled)\n"
+                  "fn func" + n + "(a: i32, b: i32) -> i32:\n"
+                  "    let mut total: i32 = pure" + n + "(a, 1.5)\n"
+                  "    let mut i: i32 = 0\n"
+                  "    while i < b:\n"
+                  "        if i % 3 == 0:\n"
+                  "            total = total + " + callee + "\n"
+                  "        else:\n"
+                  "            total = total - abs(i)\n"
+                  "        i = i + 1\n"
+                  "    return total\n";
     }
     
-    if (inputFile.empty()) {
-        printError("No input file specified");
-        printUsage(argv[0]);
+    hash::IdentifierTable identifiers;
+    hash::Lexer lexer(source, identifiers);
+    hash::Parser parser(lexer);
+    auto program = parser.parse();
+    if (!parser.getErrors().empty()) {
+        printError("Benchmark program failed to parse: " + parser.getErrors()[0]);
         return 1;
     }
+    *statusOut << "Analyzing " << program->functions.size() << " functions ("
+               << source.size() / 1024 << " KB)" << std::endl;
+    
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double baseline = 0;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, cores)) {
+        // Best of several runs, after one to warm up
+        double best = 0;
+        for (int run = 0; run < 6; run++) {
+            hash::SemanticAnalyzer analyzer(identifiers);
+            analyzer.setThreads(threads);
+            auto start = Clock::now();
+            bool ok = analyzer.analyze(*program);
+            std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+            if (!ok) {
+                printError("Benchmark program failed analysis: " + analyzer.getErrors()[0]);
+                return 1;
+            }
+            if (run == 1 || (run > 1 && elapsed.count() < best)) {
+                best = elapsed.count();
+            }
+        }
+        if (threads == 1) {
+            baseline = best;
+        }
+        *statusOut << "  " << threads << (threads == 1 ? " thread:  " : " threads: ") << best
+                   << " ms, " << baseline / best << "x" << std::endl;
+        if (threads == cores) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// Compiles one program: inputFiles[0] and whatever it imports, plus any
+// further input files, which are linked in as if every input imported the
+// others. Returns the process exit status.
+int compileProgram(const std::vector<std::string>& inputFiles, const std::string& outputFile,
+                   const CompileOptions& options) {
+    const std::string& inputFile = inputFiles[0];
+    
+    std::string rawProfileFile = options.rawProfileFile;
+    if (options.profileGenerate && rawProfileFile.empty()) {
+        rawProfileFile = fs::path(inputFile).stem().string() + ".profraw";
+    }
+    
+    // Profiles change the generated code, so their contents are part of
+    // the cache key and incremental fingerprints
+    std::string profileKey;
+    if (options.profileGenerate) {
+        profileKey = "profile-generate=" + rawProfileFile;
+    } else if (!options.profileUseFile.empty()) {
+        profileKey = "profile-use=" + options.profileUseKey;
+    }
     
-    // Read source file
-    std::string source = readFile(inputFile);
-    if (source.empty()) {
+    // Every file of the program is loaded once, memory-mapped where
+    // possible, and shared by the lexer, parser and diagnostics
+    hash::SourceManager sources;
+    const hash::SourceFile* sourceFile = sources.load(inputFile);
+    if (!sourceFile) {
+        *errorOut << "Error: Could not open file '" << inputFile << "'" << std::endl;
         return 1;
     }
+    std::string_view source = sourceFile->getText();
+    // Identifiers of every module, interned while lexing
+    hash::IdentifierTable identifiers;
     
-    std::cout << "Compiling \033[1m" << inputFile << "\033[0m...\n" << std::endl;
+    printStatus("Compiling \033[1m" + inputFile + "\033[0m...\n");
     
-    // Lexical analysis
-    std::cout << "Lexical analysis..." << std::endl;
-    hash::Lexer lexer(source);
-    auto tokens = lexer.tokenize();
+    if (options.benchLexer) {
+        benchmarkLexer(source);
+        return 0;
+    }
     
-    if (printTokens) {
-        std::cout << "\nTokens:\n";
-        for (const auto& token : tokens) {
-            std::cout << "  " << static_cast<int>(token.type) << ": '"
+    if (options.printTokens) {
+        printStatus("Lexical analysis...");
+        hash::Lexer lexer(source, identifiers);
+        *statusOut << "\nTokens:\n";
+        hash::Token token;
+        do {
+            token = lexer.next();
+            *statusOut << "  " << static_cast<int>(token.type) << ": '"
                      << token.value << "' (line " << token.line << ")" << std::endl;
-        }
+        } while (token.type != hash::TokenType::END_OF_FILE);
         return 0;
     }
     
-    printSuccess("Lexical analysis completed");
-    
-    // Parsing
-    std::cout << "Parsing..." << std::endl;
-    hash::Parser parser(tokens);
+    // Parsing; large files are lexed and parsed in pieces on several threads
+    printStatus("Lexing and parsing...");
+    hash::Parser parser(source, identifiers);
+    parser.setThreads(options.frontendThreads);
     auto program = parser.parse();
     
     if (!parser.getErrors().empty()) {
-        std::cerr << "\n\033[1;31mParsing errors:\033[0m\n";
+        *errorOut << "\n\033[1;31mParsing errors:\033[0m\n";
         for (const auto& error : parser.getErrors()) {
             printError(error, inputFile);
         }
         return 1;
     }
     
-    printSuccess("Parsing completed");
+    // Load every file reachable through imports
+    hash::ModuleGraph graph(sources, identifiers);
+    graph.setParserThreads(options.frontendThreads);
+    std::vector<std::string> extraRoots(inputFiles.begin() + 1, inputFiles.end());
+    if (!graph.load(inputFile, source, program, extraRoots)) {
+        *errorOut << "\n\033[1;31mImport errors:\033[0m\n";
+        for (const auto& error : graph.getErrors()) {
+            printError(error);
+        }
+        return 1;
+    }
+    const auto& modules = graph.getModules();
+    
+    printSuccess(modules.size() > 1 ? "Parsing completed (" + std::to_string(modules.size()) + " modules)"
+                                    : "Parsing completed");
     
-    if (printAST) {
-        std::cout << "\nAST generated successfully (visualization not implemented)" << std::endl;
+    if (options.printAST) {
+        *statusOut << "\nAST generated successfully (visualization not implemented)" << std::endl;
         return 0;
     }
     
-    // Semantic analysis
-    std::cout << "Semantic analysis..." << std::endl;
-    hash::SemanticAnalyzer analyzer;
-    bool semanticSuccess = analyzer.analyze(*program);
+    // Every module gets the same settings as the root
+    auto configure = [&](hash::CodeGenerator& generator) {
+        generator.setOptLevel(options.optLevel);
+        generator.setTargetTriple(options.targetTriple);
+        generator.setTargetCPU(options.targetCPU);
+        generator.setTargetFeatures(options.targetFeatures);
+        generator.setCodegenThreads(options.codegenThreads);
+        if (options.profileGenerate) {
+            generator.setProfileGenerate(rawProfileFile);
+        }
+        generator.setProfileUse(options.profileUseFile);
+    };
+    hash::CodeGenerator codegen(*errorOut);
+    configure(codegen);
+    
+    // Executables and JIT objects are cached; IR output is not. Imported
+    // files are part of the program, so they are part of the key.
+    std::string cacheKey;
+    std::unique_ptr<llvm::ObjectCache> jitObjectCache;
+    if (options.useCache && !options.emitLLVM && !options.emitIR) {
+        std::string target = codegen.describeTarget();
+        if (!target.empty()) {
+            std::string programSource(source);
+            for (size_t i = 1; i < modules.size(); i++) {
+                programSource += '\0' + modules[i].path + '\0';
+                programSource += modules[i].source;
+            }
+            std::string kind = options.runJIT ? "jit.o" : "exe";
+            // Executables also contain whatever libhashrt they are linked with
+            std::string runtimeKey;
+            if (!options.runJIT) {
+                hash::Linker linker(target.substr(0, target.find(' ')));
+                runtimeKey = "runtime=" + hash::CompilationCache::hashFile(linker.getRuntimeLibrary());
+            }
+            cacheKey = hash::CompilationCache::computeKey(programSource, {
+                kind,
+                target,
+                "-O" + std::to_string(static_cast<int>(options.optLevel)),
+                profileKey,
+                runtimeKey,
+            });
+            
+            if (options.runJIT) {
+                if (auto object = options.cache->lookupBuffer(cacheKey, kind)) {
+                    int exitCode = 0;
+                    if (!codegen.runJITObject(std::move(object), exitCode)) {
+                        printError("JIT execution failed");
+                        return 1;
+                    }
+                    if (options.printCacheStats) {
+                        options.cache->printStatistics(*errorOut);
+                    }
+                    return exitCode;
+                }
+                jitObjectCache = options.cache->createJITObjectCache(cacheKey);
+                codegen.setObjectCache(jitObjectCache.get());
+            } else {
+                std::string cached = options.cache->lookup(cacheKey, kind);
+                std::error_code EC;
+                if (!cached.empty() &&
+                    fs::copy_file(cached, outputFile, fs::copy_options::overwrite_existing, EC)) {
+                    printSuccess("Executable created from cache: " + outputFile);
+                    if (options.printCacheStats) {
+                        *statusOut << "\n";
+                        options.cache->printStatistics(*statusOut);
+                    }
+                    return 0;
+                }
+            }
+        }
+    }
+    
+    // Semantic analysis. Each module only needs the interfaces of the ones
+    // it imports, so modules are analyzed in parallel, sharing the thread
+    // budget between them.
+    printStatus("Semantic analysis...");
+    unsigned frontendThreads = options.frontendThreads;
+    if (frontendThreads == 0) {
+        frontendThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    unsigned analyzerThreads = std::max<unsigned>(1, frontendThreads / modules.size());
+    std::vector<std::unique_ptr<hash::SemanticAnalyzer>> analyzers;
+    for (size_t i = 0; i < modules.size(); i++) {
+        analyzers.push_back(std::make_unique<hash::SemanticAnalyzer>(identifiers));
+        analyzers[i]->setThreads(analyzerThreads);
+        analyzers[i]->addImportedFunctions(graph.getImportedFunctions(i));
+    }
+    std::vector<char> analyzed(modules.size());
+    forEachModule(modules.size(), [&](size_t i) {
+        analyzed[i] = analyzers[i]->analyze(*modules[i].program);
+    });
     
-    if (!semanticSuccess || !analyzer.getErrors().empty() || !analyzer.getWarnings().empty()) {
-        std::cerr << "\n";
+    bool semanticSuccess = true;
+    bool semanticDiagnostics = false;
+    for (size_t i = 0; i < modules.size(); i++) {
+        const hash::SemanticAnalyzer& analyzer = *analyzers[i];
+        if (analyzed[i] && analyzer.getErrors().empty() && analyzer.getWarnings().empty()) {
+            continue;
+        }
+        
+        *errorOut << "\n";
         
-        hash::ErrorReporter reporter(source, inputFile);
+        hash::ErrorReporter reporter(modules[i].source, modules[i].path);
         
         // Add structured warnings
         for (const auto& warning : analyzer.getStructuredWarnings()) {
@@ -178,63 +561,410 @@ int main(int argc, char** argv) {
             }
         }
         
-        reporter.printDiagnostics();
+        reporter.printDiagnostics(*errorOut);
         
-        if (!semanticSuccess || !analyzer.getErrors().empty()) {
-            return 1;
+        semanticDiagnostics = true;
+        if (!analyzed[i] || !analyzer.getErrors().empty()) {
+            semanticSuccess = false;
         }
-    } else {
+    }
+    if (!semanticSuccess) {
+        return 1;
+    }
+    if (!semanticDiagnostics) {
         printSuccess("Semantic analysis completed");
     }
     
+    std::string moduleName = fs::path(inputFile).stem().string();
+    
+    // Incremental builds only apply to single-file executables; IR output
+    // and the JIT need the whole module
+    if (options.incremental && modules.size() > 1) {
+        printWarning("--incremental is ignored for programs with imports");
+    }
+    std::unique_ptr<hash::IncrementalStore> incrementalStore;
+    if (options.incremental && modules.size() == 1 && !options.runJIT && !options.emitLLVM && !options.emitIR) {
+        std::string configuration = "hashc " + hash::CompilationCache::getCompilerIdentity()
+            + " llvm " LLVM_VERSION_STRING " " + codegen.describeTarget() + " -O" + std::to_string(static_cast<int>(options.optLevel)) + " " + profileKey;
+        incrementalStore = std::make_unique<hash::IncrementalStore>(
+            (fs::path(options.incrementalDir) / moduleName).string(), configuration);
+        incrementalStore->fingerprint(*program);
+        codegen.setIncrementalStore(incrementalStore.get());
+    }
+    
     // Code generation
-    std::cout << "Code generation..." << std::endl;
-    hash::CodeGenerator codegen;
+    printStatus("Code generation...");
     
-    std::string moduleName = fs::path(inputFile).stem().string();
-    if (!codegen.generate(*program, moduleName)) {
+    // Multi-file programs: every module is generated and pre-link optimized
+    // on its own thread, in its own context, and written as ThinLTO bitcode.
+    // Imported modules collect their errors separately, printed in module
+    // order once all are generated.
+    std::vector<std::ostringstream> importedErrors(modules.size() > 1 ? modules.size() - 1 : 0);
+    std::vector<std::unique_ptr<hash::CodeGenerator>> importedGenerators;
+    std::vector<llvm::SmallVector<char, 0>> moduleBitcode(modules.size());
+    if (modules.size() > 1) {
+        std::vector<hash::CodeGenerator*> generators = {&codegen};
+        for (size_t i = 1; i < modules.size(); i++) {
+            importedGenerators.push_back(std::make_unique<hash::CodeGenerator>(importedErrors[i - 1]));
+            configure(*importedGenerators.back());
+            generators.push_back(importedGenerators.back().get());
+        }
+        
+        std::vector<char> generated(modules.size());
+        forEachModule(modules.size(), [&](size_t i) {
+            generators[i]->setThinLTO(true);
+            generators[i]->setImportedFunctions(graph.getImportedFunctions(i));
+            generated[i] = generators[i]->generate(*modules[i].program, modules[i].name) &&
+                           generators[i]->emitThinLTOBitcode(moduleBitcode[i]);
+        });
+        for (const auto& errors : importedErrors) {
+            *errorOut << errors.str();
+        }
+        for (size_t i = 0; i < modules.size(); i++) {
+            if (!generated[i]) {
+                printError("Code generation failed", modules[i].path);
+                return 1;
+            }
+        }
+        
+        // The JIT and IR output want one module: link the others into the root
+        if (options.runJIT || options.emitLLVM || options.emitIR) {
+            std::vector<llvm::SmallVector<char, 0>> imported(moduleBitcode.begin() + 1, moduleBitcode.end());
+            if (!codegen.linkModules(imported)) {
+                printError("Linking modules failed");
+                return 1;
+            }
+        }
+    } else if (!codegen.generate(*program, moduleName)) {
         printError("Code generation failed");
         return 1;
     }
     
     printSuccess("Code generation completed");
     
+    if (options.runJIT) {
+        int exitCode = 0;
+        if (!codegen.runJIT(exitCode)) {
+            printError("JIT execution failed");
+            return 1;
+        }
+        if (options.printCacheStats && options.cache) {
+            options.cache->printStatistics(*errorOut);
+        }
+        return exitCode;
+    }
+    
     // Output
-    if (emitLLVM || emitIR) {
+    if (options.emitLLVM || options.emitIR) {
         std::string irFile = outputFile;
-        if (!emitLLVM) {
+        if (!options.emitLLVM) {
             irFile = moduleName + ".ll";
         }
         
-        std::cout << "Emitting LLVM IR to " << irFile << "..." << std::endl;
+        printStatus("Emitting LLVM IR to " + irFile + "...");
         codegen.emitLLVMIR(irFile);
         printSuccess("LLVM IR emitted successfully");
     } else {
-        std::string objFile = moduleName + ".o";
-        std::cout << "Generating object file..." << std::endl;
-        codegen.emitObjectFile(objFile);
-        printSuccess("Object file generated: " + objFile);
-        
-        // Link with clang
-        std::cout << "Linking..." << std::endl;
-        #ifdef _WIN32
-        std::string linkCmd = "clang++ " + objFile + " -o " + outputFile + " -llegacy_stdio_definitions";
-        #else
-        std::string linkCmd = "clang++ " + objFile + " -o " + outputFile;
-        #endif
-        int result = system(linkCmd.c_str());
+        printStatus("Generating object file...");
+        std::vector<llvm::SmallVector<char, 0>> objects;
+        bool emitted;
+        if (modules.size() > 1) {
+            printStatus("Linking modules with ThinLTO...");
+            emitted = codegen.thinLink(moduleBitcode, objects);
+        } else if (incrementalStore) {
+            emitted = codegen.emitIncrementalObjects(objects);
+        } else {
+            emitted = codegen.emitObjects(objects);
+        }
+        if (!emitted) {
+            printError("Object file generation failed");
+            return 1;
+        }
+        std::vector<llvm::ArrayRef<char>> objectRefs;
+        size_t objectBytes = 0;
+        for (const auto& object : objects) {
+            objectRefs.push_back(object);
+            objectBytes += object.size();
+        }
+        std::string partitions = objects.size() > 1 ? ", " + std::to_string(objects.size()) +
+                                 (modules.size() > 1 ? " modules" : " partitions") : "";
+        printSuccess("Object code generated (" + std::to_string(objectBytes) + " bytes" + partitions + ")");
         
-        if (result == 0) {
+        printStatus("Linking...");
+        hash::Linker linker(codegen.getTargetTriple());
+        linker.setProfileRuntime(options.profileGenerate);
+        if (linker.link(objectRefs, outputFile)) {
             printSuccess("Executable created: " + outputFile);
-            
-            // Clean up object file
-            fs::remove(objFile);
+            if (!cacheKey.empty()) {
+                options.cache->storeFile(cacheKey, "exe", outputFile);
+            }
         } else {
-            printError("Linking failed");
+            printError("Linking failed: " + linker.getError());
             return 1;
         }
     }
     
-    std::cout << "\n\033[1;32mCompilation successful!\033[0m" << std::endl;
+    *statusOut << "\n\033[1;32mCompilation successful!\033[0m" << std::endl;
+    if (options.printCacheStats && options.cache) {
+        *statusOut << "\n";
+        options.cache->printStatistics(*statusOut);
+    }
     return 0;
 }
+
+// Compiles every input as its own program on a pool of worker threads. Each
+// worker has its own CodeGenerator and so its own LLVMContext; the target
+// registry is set up once for all of them. A file's messages are buffered
+// and printed together when it finishes.
+int compileBatch(const std::vector<std::string>& inputFiles, const CompileOptions& options, unsigned jobs) {
+    // Outputs are named after the inputs, so two inputs must not share a name
+    std::unordered_map<std::string, std::string> outputs;
+    std::vector<std::string> outputFiles;
+    for (const auto& inputFile : inputFiles) {
+        std::string outputFile = fs::path(inputFile).stem().string();
+        if (options.emitLLVM) {
+            outputFile += ".ll";
+        } else {
+            #ifdef _WIN32
+            outputFile += ".exe";
+            #endif
+        }
+        auto inserted = outputs.emplace(outputFile, inputFile);
+        if (!inserted.second) {
+            printError("'" + inputFile + "' and '" + inserted.first->second + "' would both be compiled to '" +
+                       outputFile + "'");
+            return 1;
+        }
+        outputFiles.push_back(outputFile);
+    }
+    
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    jobs = std::min<size_t>(jobs, inputFiles.size());
+    // The workers already keep the cores busy
+    CompileOptions workerOptions = options;
+    if (jobs > 1) {
+        workerOptions.frontendThreads = 1;
+    }
+    
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failures(0);
+    std::mutex outputMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < inputFiles.size(); i = next++) {
+            std::ostringstream status;
+            std::ostringstream errors;
+            statusOut = &status;
+            errorOut = &errors;
+            if (compileProgram({inputFiles[i]}, outputFiles[i], workerOptions) != 0) {
+                failures++;
+            }
+            
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << status.str() << std::flush;
+            std::cerr << errors.str() << std::flush;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < jobs; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    
+    if (failures > 0) {
+        printError(std::to_string(failures.load()) + " of " + std::to_string(inputFiles.size()) +
+                   " files failed to compile");
+        return 1;
+    }
+    printStatus("\n\033[1;32mCompiled " + std::to_string(inputFiles.size()) + " files\033[0m");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    std::vector<std::string> inputFiles;
+    #ifdef _WIN32
+    std::string outputFile = "a.exe";
+    #else
+    std::string outputFile = "a.out";
+    #endif
+    bool outputGiven = false;
+    unsigned jobs = 0;
+    CompileOptions options;
+    std::string cacheDir;
+    uint64_t cacheSizeMB = 1024;
+    if (const char* envCacheDir = std::getenv("HASH_CACHE_DIR")) {
+        if (*envCacheDir) {
+            options.useCache = true;
+            cacheDir = envCacheDir;
+        }
+    }
+    
+    // Parse command line arguments
+    int firstArg = 1;
+    if (std::string(argv[1]) == "run") {
+        options.runJIT = true;
+        firstArg = 2;
+    }
+    
+    for (int i = firstArg; i < argc; i++) {
+        std::string arg = argv[i];
+        
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg == "-o") {
+            if (i + 1 < argc) {
+                outputFile = argv[++i];
+                outputGiven = true;
+            } else {
+                printError("Expected output file after -o");
+                return 1;
+            }
+        } else if (arg == "--emit-llvm") {
+            options.emitLLVM = true;
+        } else if (arg == "--emit-ir") {
+            options.emitIR = true;
+        } else if (arg == "--ast") {
+            options.printAST = true;
+        } else if (arg == "--tokens") {
+            options.printTokens = true;
+        } else if (arg == "--bench-lexer") {
+            options.benchLexer = true;
+        } else if (arg == "--bench-parser") {
+            return benchmarkParser();
+        } else if (arg == "--bench-semantic") {
+            return benchmarkSemantic();
+        } else if (arg == "--jit") {
+            options.runJIT = true;
+        } else if (arg == "-O0") {
+            options.optLevel = hash::OptLevel::O0;
+        } else if (arg == "-O1") {
+            options.optLevel = hash::OptLevel::O1;
+        } else if (arg == "-O2" || arg == "-O") {
+            options.optLevel = hash::OptLevel::O2;
+        } else if (arg == "-O3") {
+            options.optLevel = hash::OptLevel::O3;
+        } else if (arg == "-Os") {
+            options.optLevel = hash::OptLevel::Os;
+        } else if (arg == "-Oz") {
+            options.optLevel = hash::OptLevel::Oz;
+        } else if (arg.rfind("--target=", 0) == 0) {
+            options.targetTriple = arg.substr(9);
+        } else if (arg.rfind("--target-cpu=", 0) == 0) {
+            options.targetCPU = arg.substr(13);
+        } else if (arg.rfind("-mcpu=", 0) == 0 || arg.rfind("-march=", 0) == 0) {
+            options.targetCPU = arg.substr(arg.find('=') + 1);
+        } else if (arg.rfind("--target-features=", 0) == 0) {
+            options.targetFeatures = arg.substr(18);
+        } else if (arg.rfind("-mattr=", 0) == 0) {
+            options.targetFeatures = arg.substr(7);
+        } else if (arg == "--profile-generate") {
+            options.profileGenerate = true;
+        } else if (arg.rfind("--profile-generate=", 0) == 0) {
+            options.profileGenerate = true;
+            options.rawProfileFile = arg.substr(19);
+        } else if (arg.rfind("--profile-use=", 0) == 0) {
+            options.profileUseFile = arg.substr(14);
+        } else if (arg.rfind("-j", 0) == 0 || arg.rfind("--codegen-threads=", 0) == 0) {
+            std::string count;
+            if (arg == "-j") {
+                if (i + 1 >= argc) {
+                    printError("Expected thread count after -j");
+                    return 1;
+                }
+                count = argv[++i];
+            } else {
+                count = arg.substr(arg[1] == 'j' ? 2 : 18);
+            }
+            if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+                printError("Invalid thread count: " + count);
+                return 1;
+            }
+            options.codegenThreads = static_cast<unsigned>(std::stoul(count));
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            std::string count = arg.substr(7);
+            if (count.empty() || count.find_first_not_of("0123456789") != std::string::npos) {
+                printError("Invalid job count: " + count);
+                return 1;
+            }
+            jobs = static_cast<unsigned>(std::stoul(count));
+        } else if (arg == "--cache") {
+            options.useCache = true;
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            options.useCache = true;
+            cacheDir = arg.substr(12);
+        } else if (arg.rfind("--cache-size=", 0) == 0) {
+            std::string size = arg.substr(13);
+            if (size.empty() || size.find_first_not_of("0123456789") != std::string::npos) {
+                printError("Invalid cache size: " + size);
+                return 1;
+            }
+            cacheSizeMB = std::stoull(size);
+        } else if (arg == "--cache-stats") {
+            options.printCacheStats = true;
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg.rfind("--incremental-dir=", 0) == 0) {
+            options.incremental = true;
+            options.incrementalDir = arg.substr(18);
+        } else if (arg[0] == '-' && arg != "-") {
+            printError("Unknown option: " + arg);
+            return 1;
+        } else {
+            inputFiles.push_back(arg);
+        }
+    }
+    
+    if (cacheDir.empty()) {
+        cacheDir = hash::CompilationCache::getDefaultDirectory();
+    }
+    std::unique_ptr<hash::CompilationCache> cache;
+    if (options.useCache || options.printCacheStats) {
+        cache = std::make_unique<hash::CompilationCache>(cacheDir, cacheSizeMB * 1024 * 1024);
+    }
+    options.cache = cache.get();
+    
+    if (inputFiles.empty() && options.printCacheStats) {
+        cache->printStatistics(std::cout);
+        return 0;
+    }
+    
+    if (inputFiles.empty()) {
+        printError("No input file specified");
+        printUsage(argv[0]);
+        return 1;
+    }
+    
+    if (options.profileGenerate && !options.profileUseFile.empty()) {
+        printError("--profile-generate and --profile-use cannot be combined");
+        return 1;
+    }
+    if (options.profileGenerate && options.runJIT) {
+        printError("--profile-generate needs an executable; it cannot be used with 'run'");
+        return 1;
+    }
+    if (!options.profileUseFile.empty()) {
+        std::string profile = readFile(options.profileUseFile);
+        if (profile.empty()) {
+            return 1;
+        }
+        options.profileUseKey = hash::CompilationCache::computeKey(profile, {});
+    }
+    
+    quiet = options.runJIT;
+    
+    // Several inputs with -o (or 'run') make one program; otherwise each
+    // file is compiled on its own
+    if (inputFiles.size() == 1 || outputGiven || options.runJIT) {
+        return compileProgram(inputFiles, outputFile, options);
+    }
+    return compileBatch(inputFiles, options, jobs);
+}
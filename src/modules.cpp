@@ -0,0 +1,147 @@
+#include "modules.h"
+#include "lexer.h"
+#include "parser.h"
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace hash {
+
+ModuleGraph::ModuleGraph(SourceManager& sources, IdentifierTable& identifiers)
+    : sources(sources), identifiers(identifiers) {}
+
+bool ModuleGraph::load(const std::string& rootPath, std::string_view rootSource, std::shared_ptr<Program> rootProgram,
+                       const std::vector<std::string>& extraRoots) {
+    modules.clear();
+    errors.clear();
+
+    SourceModule root;
+    root.path = rootPath;
+    root.name = fs::path(rootPath).stem().string();
+    root.source = rootSource;
+    root.program = rootProgram;
+    modules.push_back(std::move(root));
+
+    std::vector<size_t> roots = {0};
+    for (const auto& path : extraRoots) {
+        size_t index = loadModule(path);
+        if (index == modules.size()) {
+            errors.push_back("cannot open '" + path + "'");
+            continue;
+        }
+        roots.push_back(index);
+    }
+    for (size_t module : roots) {
+        for (size_t imported : roots) {
+            addImport(module, imported);
+        }
+    }
+
+    // modules grows while imports are resolved, so walk it by index
+    for (size_t i = 0; i < modules.size(); i++) {
+        resolveImports(i);
+    }
+
+    // All modules share one symbol namespace once linked, global variables
+    // included even though they are not visible to importers. Every module
+    // interns into the same table, so ids identify names.
+    std::unordered_map<IdentifierId, size_t> definitions;
+    for (size_t i = 0; i < modules.size(); i++) {
+        for (const auto& func : modules[i].program->functions) {
+            auto inserted = definitions.emplace(func->id, i);
+            if (!inserted.second) {
+                errors.push_back(modules[i].path + ":" + std::to_string(func->line) + ": function '" +
+                                 identifiers.getName(func->id) + "' is also defined in " +
+                                 modules[inserted.first->second].path);
+            }
+        }
+        for (const auto& global : modules[i].program->globals) {
+            auto inserted = definitions.emplace(global->id, i);
+            if (!inserted.second) {
+                errors.push_back(modules[i].path + ":" + std::to_string(global->line) + ": '" +
+                                 identifiers.getName(global->id) +
+                                 "' is also defined in " + modules[inserted.first->second].path);
+            }
+        }
+    }
+
+    return errors.empty();
+}
+
+void ModuleGraph::resolveImports(size_t module) {
+    fs::path directory = fs::path(modules[module].path).parent_path();
+    // Copy: loading a module may reallocate the vector
+    std::vector<Import> imports = modules[module].program->imports;
+    for (const auto& import : imports) {
+        std::string path = (directory / import.path).lexically_normal().string();
+        size_t index = loadModule(path);
+        if (index == modules.size()) {
+            errors.push_back(modules[module].path + ":" + std::to_string(import.line) + ": cannot import '" +
+                             import.path + "'");
+            continue;
+        }
+        addImport(module, index);
+    }
+}
+
+void ModuleGraph::addImport(size_t module, size_t imported) {
+    std::vector<size_t>& imports = modules[module].imports;
+    if (imported != module && std::find(imports.begin(), imports.end(), imported) == imports.end()) {
+        imports.push_back(imported);
+    }
+}
+
+size_t ModuleGraph::loadModule(const std::string& path) {
+    std::error_code EC;
+    for (size_t i = 0; i < modules.size(); i++) {
+        if (fs::equivalent(modules[i].path, path, EC)) {
+            return i;
+        }
+    }
+
+    const SourceFile* file = sources.load(path);
+    if (!file) {
+        return modules.size();
+    }
+
+    SourceModule module;
+    module.path = path;
+    module.name = fs::path(path).stem().string();
+    module.source = file->getText();
+
+    Parser parser(module.source, identifiers);
+    parser.setThreads(parserThreads);
+    module.program = parser.parse();
+    for (const auto& error : parser.getErrors()) {
+        errors.push_back(path + ": " + error);
+    }
+
+    modules.push_back(std::move(module));
+    return modules.size() - 1;
+}
+
+std::vector<FunctionInfo> ModuleGraph::getInterface(size_t module) const {
+    std::vector<FunctionInfo> exported;
+    for (const auto& func : modules[module].program->functions) {
+        FunctionInfo info(identifiers.getName(func->id), func->returnType, func->isPure);
+        for (const auto& param : func->parameters) {
+            info.paramTypes.push_back(param.type);
+        }
+        info.hasSideEffects = !func->isPure;
+        exported.push_back(info);
+    }
+    return exported;
+}
+
+std::vector<FunctionInfo> ModuleGraph::getImportedFunctions(size_t module) const {
+    std::vector<FunctionInfo> imported;
+    for (size_t index : modules[module].imports) {
+        std::vector<FunctionInfo> exported = getInterface(index);
+        imported.insert(imported.end(), exported.begin(), exported.end());
+    }
+    return imported;
+}
+
+} // namespace hash
@@ -0,0 +1,68 @@
+#ifndef HASH_MODULES_H
+#define HASH_MODULES_H
+
+#include "ast.h"
+#include "semantic.h"
+#include "source_manager.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hash {
+
+// One .hash file of a program
+struct SourceModule {
+    std::string path;       // As resolved from the import, used in diagnostics
+    std::string name;       // File stem, used as the LLVM module name
+    std::string_view source; // Owned by the graph's SourceManager
+    std::shared_ptr<Program> program;
+    std::vector<size_t> imports; // Indices into ModuleGraph::getModules()
+};
+
+// The root file and every .hash file reachable through its imports.
+//
+// Imports are resolved relative to the importing file. Each module is
+// lexed and parsed once no matter how many modules import it, and import
+// cycles are allowed: a module only needs the signatures of the functions
+// it imports, which are known right after parsing.
+class ModuleGraph {
+public:
+    // Imported files are loaded through sources and their identifiers
+    // interned into identifiers; both must outlive the graph
+    ModuleGraph(SourceManager& sources, IdentifierTable& identifiers);
+    // Threads for parsing each imported file (see Parser::setThreads)
+    void setParserThreads(unsigned count) { parserThreads = count; }
+
+    // Takes the already parsed root file and loads everything it imports.
+    // Extra roots form one program with it: every root imports all others.
+    bool load(const std::string& rootPath, std::string_view rootSource, std::shared_ptr<Program> rootProgram,
+              const std::vector<std::string>& extraRoots = {});
+
+    const std::vector<SourceModule>& getModules() const { return modules; }
+    const std::vector<std::string>& getErrors() const { return errors; }
+
+    // What a module offers its importers: the signature and declared purity
+    // of each of its functions. Non-pure functions are assumed to have side
+    // effects, since their bodies are analyzed separately.
+    std::vector<FunctionInfo> getInterface(size_t module) const;
+    // The interfaces of every module the given one imports
+    std::vector<FunctionInfo> getImportedFunctions(size_t module) const;
+
+private:
+    SourceManager& sources;
+    IdentifierTable& identifiers;
+    unsigned parserThreads = 0;
+    std::vector<SourceModule> modules;
+    std::vector<std::string> errors;
+
+    // Index of the module at path, loading and parsing it on first use;
+    // returns modules.size() on failure
+    size_t loadModule(const std::string& path);
+    void resolveImports(size_t module);
+    void addImport(size_t module, size_t imported);
+};
+
+} // namespace hash
+
+#endif // HASH_MODULES_H
@@ -1,34 +1,259 @@
 #include "parser.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <functional>
 #include <sstream>
+#include <thread>
 
 namespace hash {
 
-Parser::Parser(const std::vector<Token>& tokens)
-    : tokens(tokens), current(0) {}
+namespace {
+
+// Pieces of a file are at least this large, so each is worth a thread
+constexpr size_t minChunkBytes = 32 * 1024;
+
+// Whether the line at pos starts with fn, pure or let
+bool startsDeclaration(std::string_view source, size_t pos) {
+    for (std::string_view keyword : {"fn", "pure", "let"}) {
+        if (source.compare(pos, keyword.size(), keyword) != 0) continue;
+        size_t end = pos + keyword.size();
+        char next = end < source.size() ? source[end] : ' ';
+        if (!(std::isalnum(static_cast<unsigned char>(next)) || next == '_')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A piece of a file, parsed with an identifier table of its own
+struct Chunk {
+    std::string_view text;
+    int firstLine = 1;
+    IdentifierTable identifiers;
+    std::shared_ptr<Program> program;
+    bool failed = false;
+    std::vector<IdentifierId> ids; // Ids in the file's table, by local id
+};
+
+// Cuts source into chunks of about chunkBytes or more, each starting at a
+// top-level declaration. Tracks strings and comments the way the lexer
+// does, so a line inside a multi-line string is never taken for one.
+std::vector<Chunk> findChunks(std::string_view source, size_t chunkBytes) {
+    std::vector<std::pair<size_t, int>> starts = {{0, 1}};
+    size_t pos = 0;
+    int line = 1;
+    char quote = 0; // Of the string being scanned, or 0
+    while (pos < source.size()) {
+        // At the start of a line
+        if (!quote && pos - starts.back().first >= chunkBytes && startsDeclaration(source, pos)) {
+            starts.push_back({pos, line});
+        }
+        while (pos < source.size()) {
+            char c = source[pos++];
+            if (c == '\n') {
+                line++;
+                break;
+            }
+            if (quote) {
+                if (c == quote) {
+                    quote = 0;
+                } else if (c == '\\' && pos < source.size()) {
+                    if (source[pos++] == '\n') {
+                        line++;
+                        break;
+                    }
+                }
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '#') {
+                // Up to the end of the line, as in Lexer::skipComment
+                while (pos < source.size() && source[pos] != '\n' && source[pos] != '\r') {
+                    pos++;
+                }
+            }
+        }
+    }
+    
+    std::vector<Chunk> chunks(starts.size());
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t end = i + 1 < starts.size() ? starts[i + 1].first : source.size();
+        chunks[i].text = source.substr(starts[i].first, end - starts[i].first);
+        chunks[i].firstLine = starts[i].second;
+    }
+    return chunks;
+}
+
+// A binary operator and how tightly it binds: a higher precedence binds
+// tighter, and operators of equal precedence group to the left. Unary
+// operators bind tighter than all of these.
+struct BinaryOperator {
+    BinaryOp::Op op;
+    int precedence; // 0 if the token is not a binary operator
+};
+
+BinaryOperator getBinaryOperator(TokenType type) {
+    switch (type) {
+        case TokenType::OR:            return {BinaryOp::Op::OR, 1};
+        case TokenType::AND:           return {BinaryOp::Op::AND, 2};
+        case TokenType::BITWISE_OR:    return {BinaryOp::Op::BIT_OR, 3};
+        case TokenType::BITWISE_XOR:   return {BinaryOp::Op::BIT_XOR, 4};
+        case TokenType::BITWISE_AND:   return {BinaryOp::Op::BIT_AND, 5};
+        case TokenType::EQUAL:         return {BinaryOp::Op::EQ, 6};
+        case TokenType::NOT_EQUAL:     return {BinaryOp::Op::NE, 6};
+        case TokenType::LESS:          return {BinaryOp::Op::LT, 7};
+        case TokenType::LESS_EQUAL:    return {BinaryOp::Op::LE, 7};
+        case TokenType::GREATER:       return {BinaryOp::Op::GT, 7};
+        case TokenType::GREATER_EQUAL: return {BinaryOp::Op::GE, 7};
+        case TokenType::SHIFT_LEFT:    return {BinaryOp::Op::SHL, 8};
+        case TokenType::SHIFT_RIGHT:   return {BinaryOp::Op::SHR, 8};
+        case TokenType::PLUS:          return {BinaryOp::Op::ADD, 9};
+        case TokenType::MINUS:         return {BinaryOp::Op::SUB, 9};
+        case TokenType::MULTIPLY:      return {BinaryOp::Op::MUL, 10};
+        case TokenType::DIVIDE:        return {BinaryOp::Op::DIV, 10};
+        case TokenType::MODULO:        return {BinaryOp::Op::MOD, 10};
+        default:                       return {BinaryOp::Op::ADD, 0};
+    }
+}
+
+// Calls work on each of threadCount threads and waits for them
+void runOnThreads(size_t threadCount, const std::function<void()>& work) {
+    if (threadCount == 1) {
+        work();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(work);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Moves the identifiers of a chunk's nodes from its own table to the file's.
+// Children are queued instead of visited in place, so nesting as deep as the
+// parser accepts does not overflow the worker's stack.
+class IdentifierRemapper : public ASTVisitor {
+public:
+    explicit IdentifierRemapper(const std::vector<IdentifierId>& ids) : ids(ids) {}
+    
+    void remapAll(Program& program) {
+        program.accept(*this);
+        while (!pending.empty()) {
+            ASTNode* node = pending.back();
+            pending.pop_back();
+            node->accept(*this);
+        }
+    }
+    
+    void visit(IntegerLiteral& node) override {}
+    void visit(FloatLiteral& node) override {}
+    void visit(StringLiteral& node) override {}
+    void visit(BoolLiteral& node) override {}
+    void visit(Identifier& node) override { remap(node.id); }
+    void visit(BinaryOp& node) override {
+        pending.push_back(node.left);
+        pending.push_back(node.right);
+    }
+    void visit(UnaryOp& node) override { pending.push_back(node.operand); }
+    void visit(CallExpr& node) override {
+        remap(node.functionId);
+        pending.insert(pending.end(), node.arguments.begin(), node.arguments.end());
+    }
+    
+    void visit(VariableDecl& node) override {
+        remap(node.id);
+        if (node.initializer) pending.push_back(node.initializer);
+    }
+    void visit(Assignment& node) override {
+        remap(node.id);
+        if (node.value) pending.push_back(node.value);
+    }
+    void visit(ReturnStmt& node) override {
+        if (node.value) pending.push_back(node.value);
+    }
+    void visit(IfStmt& node) override {
+        pending.push_back(node.condition);
+        pending.insert(pending.end(), node.thenBody.begin(), node.thenBody.end());
+        pending.insert(pending.end(), node.elseBody.begin(), node.elseBody.end());
+    }
+    void visit(WhileStmt& node) override {
+        pending.push_back(node.condition);
+        pending.insert(pending.end(), node.body.begin(), node.body.end());
+    }
+    void visit(ExprStmt& node) override { pending.push_back(node.expression); }
+    
+    void visit(FunctionDecl& node) override {
+        remap(node.id);
+        for (auto& param : node.parameters) {
+            remap(param.id);
+        }
+        pending.insert(pending.end(), node.body.begin(), node.body.end());
+    }
+    void visit(Program& node) override {
+        pending.insert(pending.end(), node.globals.begin(), node.globals.end());
+        pending.insert(pending.end(), node.functions.begin(), node.functions.end());
+    }
+    
+private:
+    const std::vector<IdentifierId>& ids;
+    std::vector<ASTNode*> pending;
+    
+    void remap(IdentifierId& id) {
+        if (id != NoIdentifier) id = ids[id];
+    }
+};
+
+} // namespace
+
+Parser::Parser(Lexer& lexer)
+    : lexer(&lexer), current(0), lexed(0) {}
+
+Parser::Parser(std::string_view source, IdentifierTable& identifiers)
+    : lexer(nullptr), source(source), identifiers(&identifiers), current(0), lexed(0) {}
 
 std::shared_ptr<Program> Parser::parse() {
+    if (!lexer) {
+        return parseFile();
+    }
+    
     auto program = std::make_shared<Program>();
+    program->identifiers = &lexer->getIdentifiers();
+    context = &program->context;
     
     while (!isAtEnd()) {
         try {
             if (match(TokenType::FN) || match(TokenType::PURE)) {
                 // Reset to check for pure
-                if (tokens[current - 1].type == TokenType::PURE || 
-                    (current > 0 && tokens[current - 2].type == TokenType::PURE)) {
+                if (previous().type == TokenType::PURE || 
+                    previous(2).type == TokenType::PURE) {
                     program->functions.push_back(parseFunction());
                 } else {
                     program->functions.push_back(parseFunction());
                 }
             } else if (match(TokenType::LET)) {
                 program->globals.push_back(parseGlobalVariable());
+            } else if (match(TokenType::IMPORT)) {
+                program->imports.push_back(parseImport());
             } else if (match(TokenType::NEWLINE) || match(TokenType::INDENT) || match(TokenType::DEDENT)) {
                 continue;
             } else {
-                error("Expected function or global variable declaration");
-                synchronize();
+                error("Expected function, global variable or import declaration");
+                // Unlike synchronize(), don't stop before statements such as
+                // if, which cannot start a declaration either
+                while (!isAtEnd() && !check(TokenType::FN) && !check(TokenType::LET) &&
+                       !check(TokenType::IMPORT)) {
+                    advance();
+                }
             }
         } catch (const std::exception& e) {
             error(e.what());
+            // Drop what the abandoned declaration left on the scratch stacks
+            statementStack.clear();
+            argumentStack.clear();
+            operatorStack.clear();
+            blockDepth = 0;
             synchronize();
         }
     }
@@ -36,16 +261,90 @@ std::shared_ptr<Program> Parser::parse() {
     return program;
 }
 
-Token Parser::peek(int offset) const {
-    if (current + offset >= tokens.size()) {
-        return tokens.back();
+std::shared_ptr<Program> Parser::parseFile() {
+    size_t threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    if (threadCount == 1 || source.size() < 2 * minChunkBytes) {
+        return parseWholeFile();
+    }
+    
+    // A few chunks per thread, so threads that get small ones take more
+    std::vector<Chunk> chunks = findChunks(source, std::max(minChunkBytes, source.size() / (threadCount * 4)));
+    if (chunks.size() == 1) {
+        return parseWholeFile();
+    }
+    threadCount = std::min(threadCount, chunks.size());
+    
+    std::atomic<size_t> next(0);
+    runOnThreads(threadCount, [&]() {
+        for (size_t i = next++; i < chunks.size(); i = next++) {
+            Chunk& chunk = chunks[i];
+            Lexer chunkLexer(chunk.text, chunk.identifiers, chunk.firstLine);
+            Parser parser(chunkLexer);
+            chunk.program = parser.parse();
+            chunk.failed = !parser.getErrors().empty();
+        }
+    });
+    
+    // Error recovery may run past the end of a chunk, so a file with errors
+    // is parsed again in one piece to report exactly what that would
+    for (const auto& chunk : chunks) {
+        if (chunk.failed) {
+            return parseWholeFile();
+        }
+    }
+    
+    // Interning each chunk's identifiers in order hands out the ids lexing
+    // the whole file would have
+    for (auto& chunk : chunks) {
+        for (IdentifierId id = 0; id < chunk.identifiers.size(); id++) {
+            chunk.ids.push_back(identifiers->intern(chunk.identifiers.getName(id)));
+        }
+    }
+    next = 0;
+    runOnThreads(threadCount, [&]() {
+        for (size_t i = next++; i < chunks.size(); i = next++) {
+            IdentifierRemapper remapper(chunks[i].ids);
+            remapper.remapAll(*chunks[i].program);
+        }
+    });
+    
+    auto program = std::make_shared<Program>();
+    program->identifiers = identifiers;
+    for (auto& chunk : chunks) {
+        Program& piece = *chunk.program;
+        program->context.adopt(piece.context);
+        program->imports.insert(program->imports.end(), piece.imports.begin(), piece.imports.end());
+        program->functions.insert(program->functions.end(), piece.functions.begin(), piece.functions.end());
+        program->globals.insert(program->globals.end(), piece.globals.begin(), piece.globals.end());
+    }
+    return program;
+}
+
+std::shared_ptr<Program> Parser::parseWholeFile() {
+    Lexer fileLexer(source, *identifiers);
+    Parser parser(fileLexer);
+    auto program = parser.parse();
+    errors = parser.getErrors();
+    return program;
+}
+
+Token Parser::peek(int offset) {
+    // Pull from the lexer until the requested token is in the window
+    while (lexed <= current + offset) {
+        window[lexed % window.size()] = lexer->next();
+        lexed++;
     }
-    return tokens[current + offset];
+    return window[(current + offset) % window.size()];
+}
+
+Token Parser::previous(int distance) const {
+    if (current < static_cast<size_t>(distance)) return Token();
+    return window[(current - distance) % window.size()];
 }
 
 Token Parser::advance() {
     if (!isAtEnd()) current++;
-    return tokens[current - 1];
+    return previous();
 }
 
 bool Parser::match(TokenType type) {
@@ -66,12 +365,12 @@ bool Parser::match(const std::vector<TokenType>& types) {
     return false;
 }
 
-bool Parser::check(TokenType type) const {
+bool Parser::check(TokenType type) {
     if (isAtEnd()) return false;
     return peek().type == type;
 }
 
-bool Parser::isAtEnd() const {
+bool Parser::isAtEnd() {
     return peek().type == TokenType::END_OF_FILE;
 }
 
@@ -83,11 +382,12 @@ Token Parser::consume(TokenType type, const std::string& message) {
 
 void Parser::synchronize() {
     while (!isAtEnd()) {
-        if (tokens[current - 1].type == TokenType::NEWLINE) return;
+        if (previous().type == TokenType::NEWLINE) return;
         
         switch (peek().type) {
             case TokenType::FN:
             case TokenType::LET:
+            case TokenType::IMPORT:
             case TokenType::IF:
             case TokenType::WHILE:
             case TokenType::RETURN:
@@ -106,36 +406,57 @@ void Parser::error(const std::string& message) {
     errors.push_back(oss.str());
 }
 
-std::shared_ptr<FunctionDecl> Parser::parseFunction() {
+Import Parser::parseImport() {
+    Token start = previous();
+    std::string path;
+    
+    if (match(TokenType::STRING)) {
+        path = Lexer::unescape(previous().value);
+    } else {
+        // Dotted module names map onto directories: a.b -> a/b.hash
+        path = std::string(consume(TokenType::IDENTIFIER, "Expected module name after 'import'").value);
+        while (match(TokenType::DOT)) {
+            path += "/";
+            path += consume(TokenType::IDENTIFIER, "Expected module name after '.'").value;
+        }
+        path += ".hash";
+    }
+    
+    return Import(path, start.line, start.column);
+}
+
+FunctionDecl* Parser::parseFunction() {
     bool isPure = false;
     
     // Check if we already consumed PURE
-    if (current > 0 && tokens[current - 1].type == TokenType::PURE) {
+    if (previous().type == TokenType::PURE) {
         isPure = true;
         consume(TokenType::FN, "Expected 'fn' after 'pure'");
-    } else if (current > 0 && tokens[current - 1].type == TokenType::FN) {
+    } else if (previous().type == TokenType::FN) {
         // Already consumed FN, check if there was PURE before it
-        if (current > 1 && tokens[current - 2].type == TokenType::PURE) {
+        if (previous(2).type == TokenType::PURE) {
             isPure = true;
         }
     }
     
     Token name = consume(TokenType::IDENTIFIER, "Expected function name");
-    auto func = std::make_shared<FunctionDecl>(name.value, isPure);
+    auto func = context->create<FunctionDecl>(name.id, isPure);
     func->line = name.line;
     func->column = name.column;
     
     consume(TokenType::LPAREN, "Expected '(' after function name");
     
     // Parse parameters
+    std::vector<Parameter> parameters;
     if (!check(TokenType::RPAREN)) {
         do {
             Token paramName = consume(TokenType::IDENTIFIER, "Expected parameter name");
             consume(TokenType::COLON, "Expected ':' after parameter name");
             auto paramType = parseType();
-            func->parameters.emplace_back(paramName.value, paramType);
+            parameters.emplace_back(paramName.id, paramType);
         } while (match(TokenType::COMMA));
     }
+    func->parameters = context->list(parameters);
     
     consume(TokenType::RPAREN, "Expected ')' after parameters");
     
@@ -154,7 +475,7 @@ std::shared_ptr<FunctionDecl> Parser::parseFunction() {
     return func;
 }
 
-std::shared_ptr<VariableDecl> Parser::parseGlobalVariable() {
+VariableDecl* Parser::parseGlobalVariable() {
     bool isMutable = false;
     bool isPureLocal = false;
     
@@ -169,7 +490,7 @@ std::shared_ptr<VariableDecl> Parser::parseGlobalVariable() {
     consume(TokenType::COLON, "Expected ':' after variable name");
     
     auto type = parseType();
-    auto varDecl = std::make_shared<VariableDecl>(name.value, type, isMutable, isPureLocal);
+    auto varDecl = context->create<VariableDecl>(name.id, type, isMutable, isPureLocal);
     varDecl->line = name.line;
     varDecl->column = name.column;
     
@@ -180,7 +501,7 @@ std::shared_ptr<VariableDecl> Parser::parseGlobalVariable() {
     return varDecl;
 }
 
-std::shared_ptr<Statement> Parser::parseStatement() {
+Statement* Parser::parseStatement() {
     // Skip newlines
     while (match(TokenType::NEWLINE)) {}
     
@@ -194,8 +515,8 @@ std::shared_ptr<Statement> Parser::parseStatement() {
         return parseWhileStatement();
     }
     if (match(TokenType::RETURN)) {
-        int returnLine = tokens[current - 1].line;
-        int returnCol = tokens[current - 1].column;
+        int returnLine = previous().line;
+        int returnCol = previous().column;
         return parseReturnStatement(returnLine, returnCol);
     }
     
@@ -204,7 +525,7 @@ std::shared_ptr<Statement> Parser::parseStatement() {
         Token name = advance();
         advance(); // consume '='
         auto value = parseExpression();
-        auto assignment = std::make_shared<Assignment>(name.value, value);
+        auto assignment = context->create<Assignment>(name.id, value);
         assignment->line = name.line;
         assignment->column = name.column;
         return assignment;
@@ -212,10 +533,10 @@ std::shared_ptr<Statement> Parser::parseStatement() {
     
     // Expression statement
     auto expr = parseExpression();
-    return std::make_shared<ExprStmt>(expr);
+    return context->create<ExprStmt>(expr);
 }
 
-std::shared_ptr<VariableDecl> Parser::parseVariableDecl() {
+VariableDecl* Parser::parseVariableDecl() {
     bool isMutable = false;
     bool isPureLocal = false;
     
@@ -229,7 +550,7 @@ std::shared_ptr<VariableDecl> Parser::parseVariableDecl() {
     consume(TokenType::COLON, "Expected ':' after variable name");
     
     auto type = parseType();
-    auto varDecl = std::make_shared<VariableDecl>(name.value, type, isMutable, isPureLocal);
+    auto varDecl = context->create<VariableDecl>(name.id, type, isMutable, isPureLocal);
     varDecl->line = name.line;
     varDecl->column = name.column;
     
@@ -240,11 +561,11 @@ std::shared_ptr<VariableDecl> Parser::parseVariableDecl() {
     return varDecl;
 }
 
-std::shared_ptr<Statement> Parser::parseIfStatement() {
+Statement* Parser::parseIfStatement() {
     auto condition = parseExpression();
     consume(TokenType::COLON, "Expected ':' after if condition");
     
-    auto ifStmt = std::make_shared<IfStmt>(condition);
+    auto ifStmt = context->create<IfStmt>(condition);
     ifStmt->thenBody = parseBlock();
     
     if (match(TokenType::ELSE)) {
@@ -255,307 +576,214 @@ std::shared_ptr<Statement> Parser::parseIfStatement() {
     return ifStmt;
 }
 
-std::shared_ptr<Statement> Parser::parseWhileStatement() {
+Statement* Parser::parseWhileStatement() {
     auto condition = parseExpression();
     consume(TokenType::COLON, "Expected ':' after while condition");
     
-    auto whileStmt = std::make_shared<WhileStmt>(condition);
+    auto whileStmt = context->create<WhileStmt>(condition);
     whileStmt->body = parseBlock();
     
     return whileStmt;
 }
 
-std::shared_ptr<Statement> Parser::parseReturnStatement(int line, int column) {
+Statement* Parser::parseReturnStatement(int line, int column) {
     if (check(TokenType::NEWLINE) || check(TokenType::DEDENT)) {
-        auto stmt = std::make_shared<ReturnStmt>();
+        auto stmt = context->create<ReturnStmt>();
         stmt->line = line;
         stmt->column = column;
         return stmt;
     }
     
     auto value = parseExpression();
-    auto stmt = std::make_shared<ReturnStmt>(value);
+    auto stmt = context->create<ReturnStmt>(value);
     stmt->line = line;
     stmt->column = column;
     return stmt;
 }
 
-std::shared_ptr<Expression> Parser::parseExpression() {
-    return parseLogicalOr();
-}
-
-std::shared_ptr<Expression> Parser::parseLogicalOr() {
-    auto expr = parseLogicalAnd();
-    
-    while (match(TokenType::OR)) {
-        auto right = parseLogicalAnd();
-        expr = std::make_shared<BinaryOp>(BinaryOp::Op::OR, expr, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseLogicalAnd() {
-    auto expr = parseBitwiseOr();
-    
-    while (match(TokenType::AND)) {
-        auto right = parseBitwiseOr();
-        expr = std::make_shared<BinaryOp>(BinaryOp::Op::AND, expr, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseBitwiseOr() {
-    auto expr = parseBitwiseXor();
-    
-    while (match(TokenType::BITWISE_OR)) {
-        auto right = parseBitwiseXor();
-        expr = std::make_shared<BinaryOp>(BinaryOp::Op::BIT_OR, expr, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseBitwiseXor() {
-    auto expr = parseBitwiseAnd();
-    
-    while (match(TokenType::BITWISE_XOR)) {
-        auto right = parseBitwiseAnd();
-        expr = std::make_shared<BinaryOp>(BinaryOp::Op::BIT_XOR, expr, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseBitwiseAnd() {
-    auto expr = parseEquality();
-    
-    while (match(TokenType::BITWISE_AND)) {
-        auto right = parseEquality();
-        expr = std::make_shared<BinaryOp>(BinaryOp::Op::BIT_AND, expr, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseEquality() {
-    auto expr = parseComparison();
+// Operator precedence parsing with an explicit stack instead of recursion.
+// Operands are read one at a time. Every operator, '(' and argument list
+// waits on operatorStack until the operand after it is complete, and a
+// binary operator is built once an operator binding no tighter follows.
+Expression* Parser::parseExpression() {
+    using Kind = PendingOperator::Kind;
+    size_t base = operatorStack.size();
     
     while (true) {
-        if (match(TokenType::EQUAL)) {
-            auto right = parseComparison();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::EQ, expr, right);
-        } else if (match(TokenType::NOT_EQUAL)) {
-            auto right = parseComparison();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::NE, expr, right);
-        } else {
-            break;
-        }
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseComparison() {
-    auto expr = parseShift();
-    
-    while (true) {
-        if (match(TokenType::LESS)) {
-            auto right = parseShift();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::LT, expr, right);
-        } else if (match(TokenType::LESS_EQUAL)) {
-            auto right = parseShift();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::LE, expr, right);
-        } else if (match(TokenType::GREATER)) {
-            auto right = parseShift();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::GT, expr, right);
-        } else if (match(TokenType::GREATER_EQUAL)) {
-            auto right = parseShift();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::GE, expr, right);
-        } else {
-            break;
-        }
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseShift() {
-    auto expr = parseTerm();
-    
-    while (true) {
-        if (match(TokenType::SHIFT_LEFT)) {
-            auto right = parseTerm();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::SHL, expr, right);
-        } else if (match(TokenType::SHIFT_RIGHT)) {
-            auto right = parseTerm();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::SHR, expr, right);
-        } else {
-            break;
-        }
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseTerm() {
-    auto expr = parseFactor();
-    
-    while (true) {
-        if (match(TokenType::PLUS)) {
-            auto right = parseFactor();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::ADD, expr, right);
-        } else if (match(TokenType::MINUS)) {
-            auto right = parseFactor();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::SUB, expr, right);
-        } else {
-            break;
+        // Prefix operators, '(' and calls open before the operand
+        Expression* operand = nullptr;
+        while (!operand) {
+            TokenType type = peek().type;
+            if (type == TokenType::MINUS || type == TokenType::NOT || type == TokenType::BITWISE_NOT) {
+                advance();
+                PendingOperator unary{Kind::UNARY};
+                unary.unaryOp = type == TokenType::MINUS ? UnaryOp::Op::NEG
+                              : type == TokenType::NOT ? UnaryOp::Op::NOT
+                              : UnaryOp::Op::BIT_NOT;
+                operatorStack.push_back(unary);
+            } else if (type == TokenType::LPAREN) {
+                advance();
+                operatorStack.push_back({Kind::GROUP});
+            } else if (type == TokenType::IDENTIFIER && peek(1).type == TokenType::LPAREN) {
+                Token name = advance();
+                advance(); // consume '('
+                auto call = context->create<CallExpr>(name.id);
+                if (match(TokenType::RPAREN)) {
+                    operand = call;
+                } else {
+                    PendingOperator open{Kind::CALL};
+                    open.call = call;
+                    open.firstArgument = argumentStack.size();
+                    operatorStack.push_back(open);
+                }
+            } else {
+                operand = parsePrimary();
+            }
         }
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseFactor() {
-    auto expr = parseUnary();
-    
-    while (true) {
-        if (match(TokenType::MULTIPLY)) {
-            auto right = parseUnary();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::MUL, expr, right);
-        } else if (match(TokenType::DIVIDE)) {
-            auto right = parseUnary();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::DIV, expr, right);
-        } else if (match(TokenType::MODULO)) {
-            auto right = parseUnary();
-            expr = std::make_shared<BinaryOp>(BinaryOp::Op::MOD, expr, right);
-        } else {
-            break;
+        
+        // Finish everything the operand completes, until a binary operator
+        // continues the expression or it ends
+        while (true) {
+            while (operatorStack.size() > base && operatorStack.back().kind == Kind::UNARY) {
+                operand = context->create<UnaryOp>(operatorStack.back().unaryOp, operand);
+                operatorStack.pop_back();
+            }
+            
+            // Operators binding at least as tightly as the next one take the
+            // operand; with no next operator, all of them do
+            BinaryOperator next = getBinaryOperator(peek().type);
+            while (operatorStack.size() > base && operatorStack.back().kind == Kind::BINARY &&
+                   operatorStack.back().precedence >= next.precedence) {
+                operand = context->create<BinaryOp>(operatorStack.back().binaryOp, operatorStack.back().left, operand);
+                operatorStack.pop_back();
+            }
+            if (next.precedence > 0) {
+                advance();
+                PendingOperator binary{Kind::BINARY};
+                binary.binaryOp = next.op;
+                binary.precedence = next.precedence;
+                binary.left = operand;
+                operatorStack.push_back(binary);
+                break;
+            }
+            
+            if (operatorStack.size() == base) {
+                return operand;
+            }
+            PendingOperator& open = operatorStack.back();
+            if (open.kind == Kind::GROUP) {
+                consume(TokenType::RPAREN, "Expected ')' after expression");
+                operatorStack.pop_back();
+                continue;
+            }
+            
+            // An argument
+            argumentStack.push_back(operand);
+            if (match(TokenType::COMMA)) {
+                break;
+            }
+            consume(TokenType::RPAREN, "Expected ')' after arguments");
+            open.call->arguments = context->list(argumentStack, open.firstArgument);
+            argumentStack.resize(open.firstArgument);
+            operand = open.call;
+            operatorStack.pop_back();
         }
     }
-    
-    return expr;
-}
-
-std::shared_ptr<Expression> Parser::parseUnary() {
-    if (match(TokenType::MINUS)) {
-        auto operand = parseUnary();
-        return std::make_shared<UnaryOp>(UnaryOp::Op::NEG, operand);
-    }
-    if (match(TokenType::NOT)) {
-        auto operand = parseUnary();
-        return std::make_shared<UnaryOp>(UnaryOp::Op::NOT, operand);
-    }
-    if (match(TokenType::BITWISE_NOT)) {
-        auto operand = parseUnary();
-        return std::make_shared<UnaryOp>(UnaryOp::Op::BIT_NOT, operand);
-    }
-    
-    return parsePrimary();
 }
 
-std::shared_ptr<Expression> Parser::parsePrimary() {
+// Literals and variables; parseExpression handles everything built from them
+Expression* Parser::parsePrimary() {
     if (match(TokenType::INTEGER)) {
-        auto lit = std::make_shared<IntegerLiteral>(std::stoll(tokens[current - 1].value));
+        auto lit = context->create<IntegerLiteral>(std::stoll(std::string(previous().value)));
         lit->type = Type::getI32();  // Default to i32 like C
         return lit;
     }
     
     if (match(TokenType::FLOAT)) {
-        auto lit = std::make_shared<FloatLiteral>(std::stod(tokens[current - 1].value));
+        auto lit = context->create<FloatLiteral>(std::stod(std::string(previous().value)));
         lit->type = Type::getF64();
         return lit;
     }
     
     if (match(TokenType::STRING)) {
-        auto lit = std::make_shared<StringLiteral>(tokens[current - 1].value);
+        auto lit = context->create<StringLiteral>(Lexer::unescape(previous().value));
         lit->type = Type::getStr();
         return lit;
     }
     
     if (match(TokenType::TRUE)) {
-        auto lit = std::make_shared<BoolLiteral>(true);
+        auto lit = context->create<BoolLiteral>(true);
         lit->type = Type::getBool();
         return lit;
     }
     
     if (match(TokenType::FALSE)) {
-        auto lit = std::make_shared<BoolLiteral>(false);
+        auto lit = context->create<BoolLiteral>(false);
         lit->type = Type::getBool();
         return lit;
     }
     
     if (match(TokenType::IDENTIFIER)) {
-        std::string name = tokens[current - 1].value;
-        
-        // Check for function call
-        if (match(TokenType::LPAREN)) {
-            auto call = std::make_shared<CallExpr>(name);
-            
-            if (!check(TokenType::RPAREN)) {
-                do {
-                    call->arguments.push_back(parseExpression());
-                } while (match(TokenType::COMMA));
-            }
-            
-            consume(TokenType::RPAREN, "Expected ')' after arguments");
-            return call;
-        }
-        
-        return std::make_shared<Identifier>(name);
-    }
-    
-    if (match(TokenType::LPAREN)) {
-        auto expr = parseExpression();
-        consume(TokenType::RPAREN, "Expected ')' after expression");
-        return expr;
+        Token name = previous();
+        return context->create<Identifier>(name.id);
     }
     
     error("Expected expression");
     throw std::runtime_error("Expected expression");
 }
 
-std::shared_ptr<Type> Parser::parseType() {
-    if (match(TokenType::TYPE_I8)) return std::make_shared<Type>(Type::Kind::I8);
-    if (match(TokenType::TYPE_I16)) return std::make_shared<Type>(Type::Kind::I16);
-    if (match(TokenType::TYPE_I32)) return std::make_shared<Type>(Type::Kind::I32);
-    if (match(TokenType::TYPE_I64)) return std::make_shared<Type>(Type::Kind::I64);
-    if (match(TokenType::TYPE_U8)) return std::make_shared<Type>(Type::Kind::U8);
-    if (match(TokenType::TYPE_U16)) return std::make_shared<Type>(Type::Kind::U16);
-    if (match(TokenType::TYPE_U32)) return std::make_shared<Type>(Type::Kind::U32);
-    if (match(TokenType::TYPE_U64)) return std::make_shared<Type>(Type::Kind::U64);
-    if (match(TokenType::TYPE_F32)) return std::make_shared<Type>(Type::Kind::F32);
-    if (match(TokenType::TYPE_F64)) return std::make_shared<Type>(Type::Kind::F64);
-    if (match(TokenType::TYPE_BOOL)) return std::make_shared<Type>(Type::Kind::BOOL);
-    if (match(TokenType::TYPE_VOID)) return std::make_shared<Type>(Type::Kind::VOID);
-    if (match(TokenType::TYPE_STR)) return std::make_shared<Type>(Type::Kind::STR);
+const Type* Parser::parseType() {
+    if (match(TokenType::TYPE_I8)) return Type::get(Type::Kind::I8);
+    if (match(TokenType::TYPE_I16)) return Type::get(Type::Kind::I16);
+    if (match(TokenType::TYPE_I32)) return Type::get(Type::Kind::I32);
+    if (match(TokenType::TYPE_I64)) return Type::get(Type::Kind::I64);
+    if (match(TokenType::TYPE_U8)) return Type::get(Type::Kind::U8);
+    if (match(TokenType::TYPE_U16)) return Type::get(Type::Kind::U16);
+    if (match(TokenType::TYPE_U32)) return Type::get(Type::Kind::U32);
+    if (match(TokenType::TYPE_U64)) return Type::get(Type::Kind::U64);
+    if (match(TokenType::TYPE_F32)) return Type::get(Type::Kind::F32);
+    if (match(TokenType::TYPE_F64)) return Type::get(Type::Kind::F64);
+    if (match(TokenType::TYPE_BOOL)) return Type::get(Type::Kind::BOOL);
+    if (match(TokenType::TYPE_VOID)) return Type::get(Type::Kind::VOID);
+    if (match(TokenType::TYPE_STR)) return Type::get(Type::Kind::STR);
     
     error("Expected type");
     throw std::runtime_error("Expected type");
 }
 
-std::vector<std::shared_ptr<Statement>> Parser::parseBlock() {
-    std::vector<std::shared_ptr<Statement>> statements;
+NodeList<Statement*> Parser::parseBlock() {
+    if (blockDepth == maxBlockDepth) {
+        std::string message = "Blocks nested more than " + std::to_string(maxBlockDepth) + " deep";
+        error(message);
+        throw std::runtime_error(message);
+    }
+    blockDepth++;
+    
+    // Nested blocks stack their statements above ours until they are done
+    size_t first = statementStack.size();
     
     // Expect INDENT
     if (!match(TokenType::INDENT) && !match(TokenType::NEWLINE)) {
         // Single-line block (for simple statements)
-        statements.push_back(parseStatement());
-        return statements;
-    }
-    
-    // Skip additional newlines
-    while (match(TokenType::NEWLINE)) {}
-    
-    // Parse statements until DEDENT
-    while (!check(TokenType::DEDENT) && !isAtEnd()) {
-        if (match(TokenType::NEWLINE)) continue;
-        statements.push_back(parseStatement());
+        Statement* statement = parseStatement();
+        statementStack.push_back(statement);
+    } else {
+        // Skip additional newlines
+        while (match(TokenType::NEWLINE)) {}
+        
+        // Parse statements until DEDENT
+        while (!check(TokenType::DEDENT) && !isAtEnd()) {
+            if (match(TokenType::NEWLINE)) continue;
+            Statement* statement = parseStatement();
+            statementStack.push_back(statement);
+        }
+        
+        consume(TokenType::DEDENT, "Expected dedent after block");
     }
     
-    consume(TokenType::DEDENT, "Expected dedent after block");
-    
+    NodeList<Statement*> statements = context->list(statementStack, first);
+    statementStack.resize(first);
+    blockDepth--;
     return statements;
 }
 
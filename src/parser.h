@@ -3,59 +3,102 @@
 
 #include "lexer.h"
 #include "ast.h"
+#include <array>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 namespace hash {
 
 class Parser {
 public:
-    Parser(const std::vector<Token>& tokens);
+    // Pulls tokens from the lexer on demand, so the token stream is never
+    // materialized. The lexer must outlive parse().
+    Parser(Lexer& lexer);
+    // Parses a whole file. A large one is cut before top-level declarations
+    // (lines starting with fn, pure or let) and the pieces are lexed and
+    // parsed on several threads, giving the same program and errors as one
+    // Lexer would. source and identifiers must outlive parse().
+    Parser(std::string_view source, IdentifierTable& identifiers);
+    // Threads for parsing a whole file, 0 for all cores
+    void setThreads(unsigned count) { threads = count; }
     std::shared_ptr<Program> parse();
     
     const std::vector<std::string>& getErrors() const { return errors; }
     
 private:
-    std::vector<Token> tokens;
+    Lexer* lexer; // Null when parsing a whole file
+    std::string_view source;
+    IdentifierTable* identifiers = nullptr;
+    unsigned threads = 0;
+    
+    // Ring buffer over the token stream holding the last two consumed tokens
+    // (see previous()) and up to two tokens of lookahead (peek(0), peek(1)).
+    // current and lexed are absolute token indices.
+    std::array<Token, 4> window;
     size_t current;
+    size_t lexed;
     std::vector<std::string> errors;
     
+    // Nodes are created in the program's context
+    ASTContext* context = nullptr;
+    // Scratch space for blocks and argument lists while they are parsed;
+    // finished lists are copied into the context in one piece
+    std::vector<Statement*> statementStack;
+    std::vector<Expression*> argumentStack;
+    
+    // What parseExpression has opened but not finished: operators waiting
+    // for their right operand, parentheses and argument lists. Keeping
+    // these here instead of on the call stack lets expressions nest as
+    // deeply as memory allows.
+    struct PendingOperator {
+        enum class Kind { BINARY, UNARY, GROUP, CALL };
+        Kind kind;
+        BinaryOp::Op binaryOp = BinaryOp::Op::ADD;
+        UnaryOp::Op unaryOp = UnaryOp::Op::NEG;
+        int precedence = 0;         // BINARY
+        Expression* left = nullptr; // BINARY: the left operand
+        CallExpr* call = nullptr;   // CALL
+        size_t firstArgument = 0;   // CALL: where its arguments start on argumentStack
+    };
+    std::vector<PendingOperator> operatorStack;
+    
+    // Blocks enclosing the one being parsed. Statements are parsed, analyzed
+    // and generated recursively, one call per block, so blocks nested past
+    // maxBlockDepth are an error instead of a stack overflow. A single-line
+    // block nests without indenting, so this is not bounded by the lexer.
+    int blockDepth = 0;
+    static constexpr int maxBlockDepth = 256;
+    
+    std::shared_ptr<Program> parseFile();
+    std::shared_ptr<Program> parseWholeFile();
+    
     // Helper methods
-    Token peek(int offset = 0) const;
+    Token peek(int offset = 0);
+    Token previous(int distance = 1) const;
     Token advance();
     bool match(TokenType type);
     bool match(const std::vector<TokenType>& types);
-    bool check(TokenType type) const;
-    bool isAtEnd() const;
+    bool check(TokenType type);
+    bool isAtEnd();
     Token consume(TokenType type, const std::string& message);
     void synchronize();
     void error(const std::string& message);
     
     // Parsing methods
-    std::shared_ptr<FunctionDecl> parseFunction();
-    std::shared_ptr<VariableDecl> parseGlobalVariable();
-    std::shared_ptr<Statement> parseStatement();
-    std::shared_ptr<VariableDecl> parseVariableDecl();
-    std::shared_ptr<Statement> parseIfStatement();
-    std::shared_ptr<Statement> parseWhileStatement();
-    std::shared_ptr<Statement> parseReturnStatement(int line, int column);
-    std::shared_ptr<Expression> parseExpression();
-    std::shared_ptr<Expression> parseLogicalOr();
-    std::shared_ptr<Expression> parseLogicalAnd();
-    std::shared_ptr<Expression> parseBitwiseOr();
-    std::shared_ptr<Expression> parseBitwiseXor();
-    std::shared_ptr<Expression> parseBitwiseAnd();
-    std::shared_ptr<Expression> parseEquality();
-    std::shared_ptr<Expression> parseComparison();
-    std::shared_ptr<Expression> parseShift();
-    std::shared_ptr<Expression> parseTerm();
-    std::shared_ptr<Expression> parseFactor();
-    std::shared_ptr<Expression> parseUnary();
-    std::shared_ptr<Expression> parsePrimary();
-    std::shared_ptr<Expression> parseCall(std::shared_ptr<Expression> callee);
-    
-    std::shared_ptr<Type> parseType();
-    std::vector<std::shared_ptr<Statement>> parseBlock();
+    Import parseImport();
+    FunctionDecl* parseFunction();
+    VariableDecl* parseGlobalVariable();
+    Statement* parseStatement();
+    VariableDecl* parseVariableDecl();
+    Statement* parseIfStatement();
+    Statement* parseWhileStatement();
+    Statement* parseReturnStatement(int line, int column);
+    Expression* parseExpression();
+    Expression* parsePrimary();
+    
+    const Type* parseType();
+    NodeList<Statement*> parseBlock();
 };
 
 } // namespace hash
@@ -1,266 +1,289 @@
 #include "semantic.h"
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace hash {
 
-SemanticAnalyzer::SemanticAnalyzer()
-    : currentFunction(nullptr), currentFunctionHasSideEffects(false) {}
+SemanticAnalyzer::SemanticAnalyzer(const IdentifierTable& identifiers)
+    : identifiers(identifiers), functions(ownFunctions), globalCount(0) {}
+
+SemanticAnalyzer::SemanticAnalyzer(const SemanticAnalyzer& parent)
+    : identifiers(parent.identifiers), symbols(parent.symbols), innermost(parent.innermost),
+      scopeStarts(parent.scopeStarts), functions(parent.functions), globalCount(parent.globalCount) {}
 
 bool SemanticAnalyzer::analyze(Program& program) {
     errors.clear();
     warnings.clear();
+    symbols.clear();
+    scopeStarts.clear();
+    innermost.assign(identifiers.size(), -1);
     
     program.accept(*this);
     
     return errors.empty();
 }
 
+void SemanticAnalyzer::addImportedFunctions(const std::vector<FunctionInfo>& imported) {
+    importedFunctions.insert(importedFunctions.end(), imported.begin(), imported.end());
+}
+
 void SemanticAnalyzer::visit(Program& node) {
     pushScope(); // Global scope
+    globalCount = 0;
     
     // Register built-in functions
     FunctionInfo printI32Info("print_i32", Type::getVoid(), false);
     printI32Info.paramTypes = {Type::getI32()};
-    functions["print_i32"] = printI32Info;
+    addBuiltin(Builtin::PrintI32, printI32Info);
     
     FunctionInfo printI64Info("print_i64", Type::getVoid(), false);
     printI64Info.paramTypes = {Type::getI64()};
-    functions["print_i64"] = printI64Info;
+    addBuiltin(Builtin::PrintI64, printI64Info);
     
     FunctionInfo printF64Info("print_f64", Type::getVoid(), false);
     printF64Info.paramTypes = {Type::getF64()};
-    functions["print_f64"] = printF64Info;
+    addBuiltin(Builtin::PrintF64, printF64Info);
     
     FunctionInfo printBoolInfo("print_bool", Type::getVoid(), false);
     printBoolInfo.paramTypes = {Type::getBool()};
-    functions["print_bool"] = printBoolInfo;
+    addBuiltin(Builtin::PrintBool, printBoolInfo);
     
     FunctionInfo printStrInfo("print_str", Type::getVoid(), false);
     printStrInfo.paramTypes = {Type::getStr()};
-    functions["print_str"] = printStrInfo;
+    addBuiltin(Builtin::PrintStr, printStrInfo);
     
     FunctionInfo printlnInfo("println", Type::getVoid(), false);
     printlnInfo.paramTypes = {};
-    functions["println"] = printlnInfo;
+    addBuiltin(Builtin::Println, printlnInfo);
     
     // Type conversion built-ins
     FunctionInfo i32ToI64Info("i32_to_i64", Type::getI64(), true);
     i32ToI64Info.paramTypes = {Type::getI32()};
-    functions["i32_to_i64"] = i32ToI64Info;
+    addBuiltin(Builtin::I32ToI64, i32ToI64Info);
     
     FunctionInfo i64ToI32Info("i64_to_i32", Type::getI32(), true);
     i64ToI32Info.paramTypes = {Type::getI64()};
-    functions["i64_to_i32"] = i64ToI32Info;
+    addBuiltin(Builtin::I64ToI32, i64ToI32Info);
     
     FunctionInfo i32ToF64Info("i32_to_f64", Type::getF64(), true);
     i32ToF64Info.paramTypes = {Type::getI32()};
-    functions["i32_to_f64"] = i32ToF64Info;
+    addBuiltin(Builtin::I32ToF64, i32ToF64Info);
     
     FunctionInfo f64ToI32Info("f64_to_i32", Type::getI32(), true);
     f64ToI32Info.paramTypes = {Type::getF64()};
-    functions["f64_to_i32"] = f64ToI32Info;
+    addBuiltin(Builtin::F64ToI32, f64ToI32Info);
     
     FunctionInfo i64ToF64Info("i64_to_f64", Type::getF64(), true);
     i64ToF64Info.paramTypes = {Type::getI64()};
-    functions["i64_to_f64"] = i64ToF64Info;
+    addBuiltin(Builtin::I64ToF64, i64ToF64Info);
     
     FunctionInfo f64ToI64Info("f64_to_i64", Type::getI64(), true);
     f64ToI64Info.paramTypes = {Type::getF64()};
-    functions["f64_to_i64"] = f64ToI64Info;
+    addBuiltin(Builtin::F64ToI64, f64ToI64Info);
     
     // Math built-ins
     FunctionInfo absI32Info("abs_i32", Type::getI32(), true);
     absI32Info.paramTypes = {Type::getI32()};
-    functions["abs_i32"] = absI32Info;
+    addBuiltin(Builtin::AbsI32, absI32Info);
     
     FunctionInfo minI32Info("min_i32", Type::getI32(), true);
     minI32Info.paramTypes = {Type::getI32(), Type::getI32()};
-    functions["min_i32"] = minI32Info;
+    addBuiltin(Builtin::MinI32, minI32Info);
     
     FunctionInfo maxI32Info("max_i32", Type::getI32(), true);
     maxI32Info.paramTypes = {Type::getI32(), Type::getI32()};
-    functions["max_i32"] = maxI32Info;
+    addBuiltin(Builtin::MaxI32, maxI32Info);
     
     FunctionInfo sqrtF64Info("sqrt_f64", Type::getF64(), true);
     sqrtF64Info.paramTypes = {Type::getF64()};
-    functions["sqrt_f64"] = sqrtF64Info;
+    addBuiltin(Builtin::SqrtF64, sqrtF64Info);
     
     // Python-like aliases for better ergonomics
     // print() - overloaded versions with shorter names
-    functions["print"] = printI32Info;  // Default to i32
+    addBuiltin(Builtin::Print, printI32Info);  // Default to i32
     
     // Simpler conversion names (just use int(), float(), etc.)
     FunctionInfo intInfo("int", Type::getI32(), true);
     intInfo.paramTypes = {Type::getF64()};
-    functions["int"] = intInfo;  // float to int conversion
+    addBuiltin(Builtin::Int, intInfo);  // float to int conversion
     
     FunctionInfo floatInfo("float", Type::getF64(), true);
     floatInfo.paramTypes = {Type::getI32()};
-    functions["float"] = floatInfo;  // int to float conversion
+    addBuiltin(Builtin::Float, floatInfo);  // int to float conversion
     
     // Simpler math names
     FunctionInfo absInfo("abs", Type::getI32(), true);
     absInfo.paramTypes = {Type::getI32()};
-    functions["abs"] = absInfo;
+    addBuiltin(Builtin::Abs, absInfo);
     
     FunctionInfo minInfo("min", Type::getI32(), true);
     minInfo.paramTypes = {Type::getI32(), Type::getI32()};
-    functions["min"] = minInfo;
+    addBuiltin(Builtin::Min, minInfo);
     
     FunctionInfo maxInfo("max", Type::getI32(), true);
     maxInfo.paramTypes = {Type::getI32(), Type::getI32()};
-    functions["max"] = maxInfo;
+    addBuiltin(Builtin::Max, maxInfo);
     
     FunctionInfo sqrtInfo("sqrt", Type::getF64(), true);
     sqrtInfo.paramTypes = {Type::getF64()};
-    functions["sqrt"] = sqrtInfo;
+    addBuiltin(Builtin::Sqrt, sqrtInfo);
     
     // Input functions
     FunctionInfo readI32Info("read_i32", Type::getI32(), false);
     readI32Info.paramTypes = {};
-    functions["read_i32"] = readI32Info;
+    addBuiltin(Builtin::ReadI32, readI32Info);
     
     FunctionInfo readF64Info("read_f64", Type::getF64(), false);
     readF64Info.paramTypes = {};
-    functions["read_f64"] = readF64Info;
+    addBuiltin(Builtin::ReadF64, readF64Info);
     
     // Additional Math Functions
     FunctionInfo powInfo("pow", Type::getF64(), true);
     powInfo.paramTypes = {Type::getF64(), Type::getF64()};
-    functions["pow"] = powInfo;
+    addBuiltin(Builtin::Pow, powInfo);
     
     FunctionInfo floorInfo("floor", Type::getF64(), true);
     floorInfo.paramTypes = {Type::getF64()};
-    functions["floor"] = floorInfo;
+    addBuiltin(Builtin::Floor, floorInfo);
     
     FunctionInfo ceilInfo("ceil", Type::getF64(), true);
     ceilInfo.paramTypes = {Type::getF64()};
-    functions["ceil"] = ceilInfo;
+    addBuiltin(Builtin::Ceil, ceilInfo);
     
     FunctionInfo roundInfo("round", Type::getF64(), true);
     roundInfo.paramTypes = {Type::getF64()};
-    functions["round"] = roundInfo;
+    addBuiltin(Builtin::Round, roundInfo);
     
     // Trigonometric functions
     FunctionInfo sinInfo("sin", Type::getF64(), true);
     sinInfo.paramTypes = {Type::getF64()};
-    functions["sin"] = sinInfo;
+    addBuiltin(Builtin::Sin, sinInfo);
     
     FunctionInfo cosInfo("cos", Type::getF64(), true);
     cosInfo.paramTypes = {Type::getF64()};
-    functions["cos"] = cosInfo;
+    addBuiltin(Builtin::Cos, cosInfo);
     
     FunctionInfo tanInfo("tan", Type::getF64(), true);
     tanInfo.paramTypes = {Type::getF64()};
-    functions["tan"] = tanInfo;
+    addBuiltin(Builtin::Tan, tanInfo);
     
     FunctionInfo asinInfo("asin", Type::getF64(), true);
     asinInfo.paramTypes = {Type::getF64()};
-    functions["asin"] = asinInfo;
+    addBuiltin(Builtin::Asin, asinInfo);
     
     FunctionInfo acosInfo("acos", Type::getF64(), true);
     acosInfo.paramTypes = {Type::getF64()};
-    functions["acos"] = acosInfo;
+    addBuiltin(Builtin::Acos, acosInfo);
     
     FunctionInfo atanInfo("atan", Type::getF64(), true);
     atanInfo.paramTypes = {Type::getF64()};
-    functions["atan"] = atanInfo;
+    addBuiltin(Builtin::Atan, atanInfo);
     
     // Logarithmic and exponential functions
     FunctionInfo expInfo("exp", Type::getF64(), true);
     expInfo.paramTypes = {Type::getF64()};
-    functions["exp"] = expInfo;
+    addBuiltin(Builtin::Exp, expInfo);
     
     FunctionInfo logInfo("log", Type::getF64(), true);
     logInfo.paramTypes = {Type::getF64()};
-    functions["log"] = logInfo;
+    addBuiltin(Builtin::Log, logInfo);
     
     FunctionInfo log2Info("log2", Type::getF64(), true);
     log2Info.paramTypes = {Type::getF64()};
-    functions["log2"] = log2Info;
+    addBuiltin(Builtin::Log2, log2Info);
     
     FunctionInfo log10Info("log10", Type::getF64(), true);
     log10Info.paramTypes = {Type::getF64()};
-    functions["log10"] = log10Info;
+    addBuiltin(Builtin::Log10, log10Info);
     
     // System functions
     FunctionInfo exitInfo("exit", Type::getVoid(), false);
     exitInfo.paramTypes = {Type::getI32()};
-    functions["exit"] = exitInfo;
+    addBuiltin(Builtin::Exit, exitInfo);
     
     FunctionInfo hashTimeInfo("hash_time", Type::getI64(), false);
     hashTimeInfo.paramTypes = {};
-    functions["hash_time"] = hashTimeInfo;
+    addBuiltin(Builtin::HashTime, hashTimeInfo);
     
     FunctionInfo hashClockInfo("hash_clock", Type::getF64(), false);
     hashClockInfo.paramTypes = {};
-    functions["hash_clock"] = hashClockInfo;
+    addBuiltin(Builtin::HashClock, hashClockInfo);
     
     FunctionInfo randomInfo("random", Type::getF64(), false);
     randomInfo.paramTypes = {};
-    functions["random"] = randomInfo;
+    addBuiltin(Builtin::Random, randomInfo);
     
     FunctionInfo seedRandomInfo("seed_random", Type::getVoid(), false);
     seedRandomInfo.paramTypes = {Type::getI32()};
-    functions["seed_random"] = seedRandomInfo;
+    addBuiltin(Builtin::SeedRandom, seedRandomInfo);
     
     FunctionInfo randomRangeInfo("random_range", Type::getI32(), false);
     randomRangeInfo.paramTypes = {Type::getI32(), Type::getI32()};
-    functions["random_range"] = randomRangeInfo;
+    addBuiltin(Builtin::RandomRange, randomRangeInfo);
     
     // String manipulation functions
     FunctionInfo lenInfo("len", Type::getI32(), true);  // Pure - just reads length
     lenInfo.paramTypes = {Type::getStr()};
-    functions["len"] = lenInfo;
+    addBuiltin(Builtin::Len, lenInfo);
     
     FunctionInfo strConcatInfo("str_concat", Type::getStr(), true);  // Pure - creates new string
     strConcatInfo.paramTypes = {Type::getStr(), Type::getStr()};
-    functions["str_concat"] = strConcatInfo;
+    addBuiltin(Builtin::StrConcat, strConcatInfo);
     
     FunctionInfo strEqInfo("str_eq", Type::getBool(), true);  // Pure - just compares
     strEqInfo.paramTypes = {Type::getStr(), Type::getStr()};
-    functions["str_eq"] = strEqInfo;
+    addBuiltin(Builtin::StrEq, strEqInfo);
     
     FunctionInfo upperInfo("upper", Type::getStr(), true);  // Pure - creates new string
     upperInfo.paramTypes = {Type::getStr()};
-    functions["upper"] = upperInfo;
+    addBuiltin(Builtin::Upper, upperInfo);
     
     FunctionInfo lowerInfo("lower", Type::getStr(), true);  // Pure - creates new string
     lowerInfo.paramTypes = {Type::getStr()};
-    functions["lower"] = lowerInfo;
+    addBuiltin(Builtin::Lower, lowerInfo);
     
     // File I/O functions
     FunctionInfo fileReadInfo("file_read", Type::getStr(), false);  // Impure - reads from disk
     fileReadInfo.paramTypes = {Type::getStr()};
-    functions["file_read"] = fileReadInfo;
+    addBuiltin(Builtin::FileRead, fileReadInfo);
     
     FunctionInfo fileWriteInfo("file_write", Type::getBool(), false);  // Impure - writes to disk
     fileWriteInfo.paramTypes = {Type::getStr(), Type::getStr()};
-    functions["file_write"] = fileWriteInfo;
+    addBuiltin(Builtin::FileWrite, fileWriteInfo);
     
     FunctionInfo fileExistsInfo("file_exists", Type::getBool(), false);  // Impure - checks filesystem
     fileExistsInfo.paramTypes = {Type::getStr()};
-    functions["file_exists"] = fileExistsInfo;
+    addBuiltin(Builtin::FileExists, fileExistsInfo);
     
     FunctionInfo fileDeleteInfo("file_delete", Type::getBool(), false);  // Impure - modifies filesystem
     fileDeleteInfo.paramTypes = {Type::getStr()};
-    functions["file_delete"] = fileDeleteInfo;
+    addBuiltin(Builtin::FileDelete, fileDeleteInfo);
+    
+    // Functions exported by imported modules
+    for (size_t i = 0; i < importedFunctions.size(); i++) {
+        FunctionInfo info = importedFunctions[i];
+        info.binding = Binding(Binding::Kind::IMPORTED, static_cast<uint32_t>(i));
+        addFunction(info.name, info);
+    }
     
     // First pass: collect all function signatures
-    for (auto& func : node.functions) {
-        std::vector<std::shared_ptr<Type>> paramTypes;
+    for (size_t i = 0; i < node.functions.size(); i++) {
+        FunctionDecl* func = node.functions[i];
+        std::vector<const Type*> paramTypes;
         for (auto& param : func->parameters) {
             paramTypes.push_back(param.type);
         }
         
-        FunctionInfo info(func->name, func->returnType, func->isPure);
+        FunctionInfo info(getName(func->id), func->returnType, func->isPure);
         info.paramTypes = paramTypes;
+        info.binding = Binding(Binding::Kind::FUNCTION, static_cast<uint32_t>(i));
         
-        if (functions.find(func->name) != functions.end()) {
-            error("Function '" + func->name + "' already declared", func->line, func->column);
+        if (functions.find(func->id) != functions.end()) {
+            error("Function '" + getName(func->id) + "' already declared", func->line, func->column);
         } else {
-            functions[func->name] = info;
+            functions[func->id] = info;
         }
     }
     
@@ -270,24 +293,109 @@ void SemanticAnalyzer::visit(Program& node) {
     }
     
     // Second pass: analyze function bodies
-    for (auto& func : node.functions) {
-        func->accept(*this);
-    }
+    analyzeBodies(node);
     
     popScope();
 }
 
+void SemanticAnalyzer::analyzeBodies(Program& program) {
+    size_t count = program.functions.size();
+    std::vector<BodyResult> results(count);
+    
+    // Bodies only read the function table and the global scope, and each
+    // worker has its own copy of the scopes, so any split of the bodies
+    // gives the same results
+    const size_t minBodiesPerThread = 64;
+    size_t threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, std::max<size_t>(1, count / minBodiesPerThread));
+    
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        SemanticAnalyzer worker(*this);
+        for (size_t i = next++; i < count; i = next++) {
+            results[i] = worker.analyzeBody(*program.functions[i]);
+        }
+    };
+    if (threadCount == 1) {
+        work();
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back(work);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    // Side effects flow from each body to the ones after it, so bodies are
+    // merged in source order, as if they had been analyzed one by one
+    for (size_t i = 0; i < count; i++) {
+        mergeBody(*program.functions[i], results[i]);
+    }
+}
+
+SemanticAnalyzer::BodyResult SemanticAnalyzer::analyzeBody(FunctionDecl& function) {
+    function.accept(*this);
+    
+    BodyResult result;
+    result.errors.swap(errors);
+    result.warnings.swap(warnings);
+    result.structuredErrors.swap(structuredErrors);
+    result.structuredWarnings.swap(structuredWarnings);
+    result.hasSideEffects = currentFunction.hasSideEffects;
+    result.calls.swap(currentFunction.calls);
+    return result;
+}
+
+void SemanticAnalyzer::mergeBody(FunctionDecl& function, BodyResult& result) {
+    FunctionInfo* info = lookupFunction(function.id);
+    
+    // If calling a function with side effects from a pure function, error
+    size_t inserted = 0;
+    for (const auto& call : result.calls) {
+        if (!call.callee->hasSideEffects) {
+            continue;
+        }
+        if (info->isPure) {
+            ErrorInfo err("Pure function '" + info->name + "' cannot call function '" + 
+                         call.callee->name + "' which has side effects", call.line, call.column);
+            err.suggestion = "Either remove the 'pure' keyword from function '" + info->name + 
+                             "', or only call pure functions from within it.";
+            result.structuredErrors.insert(result.structuredErrors.begin() + call.errorIndex + inserted, err);
+            inserted++;
+        }
+        result.hasSideEffects = true;
+    }
+    
+    auto append = [](auto& to, auto& from) {
+        to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+    };
+    append(errors, result.errors);
+    append(warnings, result.warnings);
+    append(structuredErrors, result.structuredErrors);
+    append(structuredWarnings, result.structuredWarnings);
+    
+    // Check if pure function has side effects
+    if (function.isPure && result.hasSideEffects) {
+        error("Pure function '" + getName(function.id) + "' has side effects", function.line, function.column);
+    }
+    
+    // Update function info
+    info->hasSideEffects = result.hasSideEffects;
+}
+
 void SemanticAnalyzer::visit(FunctionDecl& node) {
-    currentFunction = &functions[node.name];
-    currentFunctionHasSideEffects = false;
-    modifiedVariables.clear();
+    currentFunction = FunctionContext();
+    currentFunction.info = lookupFunction(node.id);
     
     pushScope(); // Function scope
     
     // Declare parameters
     for (auto& param : node.parameters) {
-        Symbol symbol(param.name, param.type, false, false, true);
-        declareVariable(param.name, symbol);
+        Symbol symbol(param.id, param.type, false, false, true);
+        symbol.binding = Binding(Binding::Kind::LOCAL, currentFunction.localCount++);
+        declareVariable(symbol);
     }
     
     // Analyze body
@@ -295,28 +403,24 @@ void SemanticAnalyzer::visit(FunctionDecl& node) {
         stmt->accept(*this);
     }
     
-    // Check if pure function has side effects
-    if (node.isPure && currentFunctionHasSideEffects) {
-        error("Pure function '" + node.name + "' has side effects", node.line, node.column);
-    }
-    
-    // Update function info
-    currentFunction->hasSideEffects = currentFunctionHasSideEffects;
+    // Whether the function has side effects, and so whether a pure one is
+    // in error, is settled by mergeBody()
+    node.localCount = currentFunction.localCount;
     
     popScope();
-    currentFunction = nullptr;
+    currentFunction.info = nullptr;
 }
 
 void SemanticAnalyzer::visit(VariableDecl& node) {
     // Check if variable already declared in current scope
-    if (!scopes.empty() && scopes.back().find(node.name) != scopes.back().end()) {
-        error("Variable '" + node.name + "' already declared in this scope", node.line, node.column);
+    if (isDeclaredInScope(node.id)) {
+        error("Variable '" + getName(node.id) + "' already declared in this scope", node.line, node.column);
         return;
     }
     
     // Analyze initializer
     if (node.initializer) {
-        node.initializer->accept(*this);
+        walker.walk(*node.initializer, *this);
         
         // Type check
         if (node.initializer->type && !typesMatch(node.varType, node.initializer->type)) {
@@ -339,71 +443,78 @@ void SemanticAnalyzer::visit(VariableDecl& node) {
     }
     
     // Declare variable
-    Symbol symbol(node.name, node.varType, node.isMutable, node.isPureLocal);
-    declareVariable(node.name, symbol);
+    Symbol symbol(node.id, node.varType, node.isMutable, node.isPureLocal);
+    if (currentFunction.info) {
+        symbol.binding = Binding(Binding::Kind::LOCAL, currentFunction.localCount++);
+    } else {
+        symbol.binding = Binding(Binding::Kind::GLOBAL, globalCount++);
+    }
+    node.binding = symbol.binding;
+    declareVariable(symbol);
 }
 
 void SemanticAnalyzer::visit(Assignment& node) {
     // Look up variable
-    Symbol* symbol = lookupVariable(node.name);
+    Symbol* symbol = lookupVariable(node.id);
     if (!symbol) {
-        error("Undefined variable '" + node.name + "'", node.line, node.column);
-        structuredErrors.back().suggestion = "Make sure '" + node.name + "' is declared before use, or check for typos";
+        error("Undefined variable '" + getName(node.id) + "'", node.line, node.column);
+        structuredErrors.back().suggestion = "Make sure '" + getName(node.id) + "' is declared before use, or check for typos";
         return;
     }
+    node.binding = symbol->binding;
     
     // Check if variable is mutable
     if (!symbol->isMutable && !symbol->isParameter) {
-        error("Cannot assign to immutable variable '" + node.name + "'", node.line, node.column);
-        structuredErrors.back().suggestion = "Declare the variable as mutable with 'let mut " + node.name + ": <type>' instead of 'let " + node.name + ": <type>'";
+        error("Cannot assign to immutable variable '" + getName(node.id) + "'", node.line, node.column);
+        structuredErrors.back().suggestion = "Declare the variable as mutable with 'let mut " + getName(node.id) + ": <type>' instead of 'let " + getName(node.id) + ": <type>'";
     }
     
     // Check pure_local access
-    if (symbol->isPureLocal && currentFunction && !currentFunction->isPure) {
-        error("Cannot modify pure_local variable '" + node.name + "' in non-pure function", 
+    if (symbol->isPureLocal && currentFunction.info && !currentFunction.info->isPure) {
+        error("Cannot modify pure_local variable '" + getName(node.id) + "' in non-pure function", 
               node.line, node.column);
         structuredErrors.back().suggestion = "Pure_local variables can only be modified by pure functions. Mark this function as 'pure fn' or use a regular variable";
     }
     
     // Analyze value
-    node.value->accept(*this);
+    walker.walk(*node.value, *this);
     
     // Type check
     if (node.value->type && !typesMatch(symbol->type, node.value->type)) {
-        error("Type mismatch in assignment to '" + node.name + "': expected " + 
+        error("Type mismatch in assignment to '" + getName(node.id) + "': expected " + 
               typeToString(symbol->type) + ", got " + typeToString(node.value->type), 
               node.line, node.column);
         structuredErrors.back().suggestion = "Ensure the assigned value matches the variable's type '" + typeToString(symbol->type) + "'";
     }
     
     // Mark as side effect
-    markSideEffect("Assignment to variable '" + node.name + "'");
-    modifiedVariables.insert(node.name);
+    markSideEffect("Assignment to variable '" + getName(node.id) + "'");
+    currentFunction.modifiedVariables.insert(node.id);
 }
 
 void SemanticAnalyzer::visit(ReturnStmt& node) {
-    if (!currentFunction) {
+    if (!currentFunction.info) {
         error("Return statement outside of function", node.line, node.column);
         structuredErrors.back().suggestion = "Return statements can only be used inside functions";
         return;
     }
     
     if (node.value) {
-        node.value->accept(*this);
+        walker.walk(*node.value, *this);
         
         // Type check
-        if (node.value->type && !typesMatch(currentFunction->returnType, node.value->type)) {
-            error("Return type mismatch: expected " + typeToString(currentFunction->returnType) + 
+        if (node.value->type && !typesMatch(currentFunction.info->returnType, node.value->type)) {
+            error("Return type mismatch: expected " + typeToString(currentFunction.info->returnType) + 
                   ", got " + typeToString(node.value->type), node.line, node.column);
             
             std::string returnType = typeToString(node.value->type);
-            std::string expectedType = typeToString(currentFunction->returnType);
+            std::string expectedType = typeToString(currentFunction.info->returnType);
             structuredErrors.back().suggestion = "Change the return value to type '" + expectedType + "', or change the function's return type to '" + returnType + "'";
         }
     } else {
         // Check if function expects void
-        if (currentFunction->returnType->kind != Type::Kind::VOID) {
-            error("Function expects return value of type " + typeToString(currentFunction->returnType), 
+        if (currentFunction.info->returnType->kind != Type::Kind::VOID) {
+            error("Function expects return value of type " + typeToString(currentFunction.info->returnType), 
                   node.line, node.column);
             structuredErrors.back().suggestion = "Add a return value: 'return <value>', or change function return type to 'void'";
         }
@@ -411,7 +522,7 @@ void SemanticAnalyzer::visit(ReturnStmt& node) {
 }
 
 void SemanticAnalyzer::visit(IfStmt& node) {
-    node.condition->accept(*this);
+    walker.walk(*node.condition, *this);
     
     // Check condition is bool
     if (node.condition->type && node.condition->type->kind != Type::Kind::BOOL) {
@@ -428,7 +539,7 @@ void SemanticAnalyzer::visit(IfStmt& node) {
 }
 
 void SemanticAnalyzer::visit(WhileStmt& node) {
-    node.condition->accept(*this);
+    walker.walk(*node.condition, *this);
     
     // Check condition is bool
     if (node.condition->type && node.condition->type->kind != Type::Kind::BOOL) {
@@ -441,7 +552,7 @@ void SemanticAnalyzer::visit(WhileStmt& node) {
 }
 
 void SemanticAnalyzer::visit(ExprStmt& node) {
-    node.expression->accept(*this);
+    walker.walk(*node.expression, *this);
 }
 
 void SemanticAnalyzer::visit(IntegerLiteral& node) {
@@ -461,30 +572,33 @@ void SemanticAnalyzer::visit(BoolLiteral& node) {
 }
 
 void SemanticAnalyzer::visit(Identifier& node) {
-    Symbol* symbol = lookupVariable(node.name);
+    Symbol* symbol = lookupVariable(node.id);
     if (!symbol) {
-        ErrorInfo err("Undefined variable '" + node.name + "'", node.line, node.column);
-        err.suggestion = "Make sure '" + node.name + "' is declared before use, or check for typos in the variable name.";
+        ErrorInfo err("Undefined variable '" + getName(node.id) + "'", node.line, node.column);
+        err.suggestion = "Make sure '" + getName(node.id) + "' is declared before use, or check for typos in the variable name.";
         structuredErrors.push_back(err);
         node.type = Type::getI32(); // Default type to continue analysis
         return;
     }
     
     // Check pure_local access
-    if (symbol->isPureLocal && currentFunction && !currentFunction->isPure) {
-        ErrorInfo err("Cannot access pure_local variable '" + node.name + "' in non-pure function", node.line, node.column);
+    if (symbol->isPureLocal && currentFunction.info && !currentFunction.info->isPure) {
+        ErrorInfo err("Cannot access pure_local variable '" + getName(node.id) + "' in non-pure function", node.line, node.column);
         err.suggestion = "Pure_local variables can only be accessed by pure functions. Either make function '" + 
-                         currentFunction->name + "' pure by adding the 'pure' keyword, or remove 'pure_local' from variable '" + 
-                         node.name + "'.";
+                         currentFunction.info->name + "' pure by adding the 'pure' keyword, or remove 'pure_local' from variable '" + 
+                         getName(node.id) + "'.";
         structuredErrors.push_back(err);
     }
     
     node.type = symbol->type;
+    node.binding = symbol->binding;
 }
 
 void SemanticAnalyzer::visit(BinaryOp& node) {
-    node.left->accept(*this);
-    node.right->accept(*this);
+    switch (walker.stage()) {
+        case 0: return walker.descend(*node.left);
+        case 1: return walker.descend(*node.right);
+    }
     
     if (!node.left->type || !node.right->type) {
         return; // Already have errors
@@ -530,7 +644,9 @@ void SemanticAnalyzer::visit(BinaryOp& node) {
 }
 
 void SemanticAnalyzer::visit(UnaryOp& node) {
-    node.operand->accept(*this);
+    if (walker.stage() == 0) {
+        return walker.descend(*node.operand);
+    }
     
     if (!node.operand->type) return;
     
@@ -553,56 +669,59 @@ void SemanticAnalyzer::visit(UnaryOp& node) {
 }
 
 void SemanticAnalyzer::visit(CallExpr& node) {
-    FunctionInfo* funcInfo = lookupFunction(node.functionName);
-    if (!funcInfo) {
-        ErrorInfo err("Undefined function '" + node.functionName + "'", node.line, node.column);
-        err.suggestion = "Make sure the function '" + node.functionName + "' is declared before calling it, or check for typos in the function name.";
+    const std::string& name = getName(node.functionId);
+    FunctionInfo* funcInfo = lookupFunction(node.functionId);
+    // Entered again after each argument, which is checked before the next
+    uint32_t walked = walker.stage();
+    if (walked == 0 && !funcInfo) {
+        ErrorInfo err("Undefined function '" + name + "'", node.line, node.column);
+        err.suggestion = "Make sure the function '" + name + "' is declared before calling it, or check for typos in the function name.";
         structuredErrors.push_back(err);
         node.type = Type::getVoid();
         return;
     }
     
     // Check argument count
-    if (node.arguments.size() != funcInfo->paramTypes.size()) {
-        ErrorInfo err("Function '" + node.functionName + "' expects " + 
+    if (walked == 0 && node.arguments.size() != funcInfo->paramTypes.size()) {
+        ErrorInfo err("Function '" + name + "' expects " + 
                      std::to_string(funcInfo->paramTypes.size()) + " arguments, got " +
                      std::to_string(node.arguments.size()), node.line, node.column);
         err.suggestion = "Provide exactly " + std::to_string(funcInfo->paramTypes.size()) + 
                          " argument" + (funcInfo->paramTypes.size() == 1 ? "" : "s") + 
-                         " when calling '" + node.functionName + "'.";
+                         " when calling '" + name + "'.";
         structuredErrors.push_back(err);
         node.type = funcInfo->returnType;
         return;
     }
     
-    // Check argument types
-    for (size_t i = 0; i < node.arguments.size(); i++) {
-        node.arguments[i]->accept(*this);
+    // Check the type of the argument just walked
+    if (walked > 0) {
+        size_t i = walked - 1;
         
         if (node.arguments[i]->type && !typesMatch(funcInfo->paramTypes[i], node.arguments[i]->type)) {
             std::string expectedType = typeToString(funcInfo->paramTypes[i]);
             std::string actualType = typeToString(node.arguments[i]->type);
             
-            ErrorInfo err("Argument " + std::to_string(i + 1) + " type mismatch in call to '" + node.functionName + "'",
+            ErrorInfo err("Argument " + std::to_string(i + 1) + " type mismatch in call to '" + name + "'",
                          node.arguments[i]->line, node.arguments[i]->column);
             err.message += ": expected " + expectedType + ", got " + actualType;
             
             // Provide specific suggestions for common math function errors
-            if (node.functionName == "pow" || node.functionName == "floor" || 
-                node.functionName == "ceil" || node.functionName == "round" || 
-                node.functionName == "sqrt" || node.functionName == "sin" || 
-                node.functionName == "cos" || node.functionName == "tan" ||
-                node.functionName == "asin" || node.functionName == "acos" || 
-                node.functionName == "atan" || node.functionName == "exp" ||
-                node.functionName == "log" || node.functionName == "log2" || 
-                node.functionName == "log10") {
+            if (name == "pow" || name == "floor" || 
+                name == "ceil" || name == "round" || 
+                name == "sqrt" || name == "sin" || 
+                name == "cos" || name == "tan" ||
+                name == "asin" || name == "acos" || 
+                name == "atan" || name == "exp" ||
+                name == "log" || name == "log2" || 
+                name == "log10") {
                 if (actualType == "i32" && expectedType == "f64") {
                     err.suggestion = "Use " + expectedType + " literal (e.g., 2.0 instead of 2) or convert with float().";
                 } else {
-                    err.suggestion = "Function '" + node.functionName + "' expects " + expectedType + " but got " + actualType + ".";
+                    err.suggestion = "Function '" + name + "' expects " + expectedType + " but got " + actualType + ".";
                 }
-            } else if (node.functionName == "int" || node.functionName == "float") {
-                err.suggestion = "Type conversion function '" + node.functionName + "()' expects " + expectedType + " but got " + actualType + ".";
+            } else if (name == "int" || name == "float") {
+                err.suggestion = "Type conversion function '" + name + "()' expects " + expectedType + " but got " + actualType + ".";
             } else {
                 err.suggestion = "Ensure argument " + std::to_string(i + 1) + " matches the expected parameter type, or add an explicit type conversion.";
             }
@@ -611,58 +730,91 @@ void SemanticAnalyzer::visit(CallExpr& node) {
         }
     }
     
+    if (walked < node.arguments.size()) {
+        return walker.descend(*node.arguments[walked]);
+    }
+    
+    // Whether a function of this program has side effects depends on the
+    // bodies before this one, so that is settled later by mergeBody()
+    if (currentFunction.info && funcInfo->binding.kind == Binding::Kind::FUNCTION) {
+        currentFunction.calls.push_back({funcInfo, node.line, node.column, structuredErrors.size()});
+        node.type = funcInfo->returnType;
+        node.binding = funcInfo->binding;
+        return;
+    }
+    
     // If calling a function with side effects from a pure function, error
-    if (currentFunction && currentFunction->isPure && funcInfo->hasSideEffects) {
-        ErrorInfo err("Pure function '" + currentFunction->name + "' cannot call function '" + 
-                     node.functionName + "' which has side effects", node.line, node.column);
-        err.suggestion = "Either remove the 'pure' keyword from function '" + currentFunction->name + 
+    if (currentFunction.info && currentFunction.info->isPure && funcInfo->hasSideEffects) {
+        ErrorInfo err("Pure function '" + currentFunction.info->name + "' cannot call function '" + 
+                     name + "' which has side effects", node.line, node.column);
+        err.suggestion = "Either remove the 'pure' keyword from function '" + currentFunction.info->name + 
                          "', or only call pure functions from within it.";
         structuredErrors.push_back(err);
     }
     
     // If the called function has side effects, current function has side effects
     if (funcInfo->hasSideEffects) {
-        markSideEffect("Call to function '" + node.functionName + "' with side effects");
+        markSideEffect("Call to function '" + name + "' with side effects");
     }
     
     node.type = funcInfo->returnType;
+    node.binding = funcInfo->binding;
 }
 
 void SemanticAnalyzer::pushScope() {
-    scopes.emplace_back();
+    scopeStarts.push_back(symbols.size());
 }
 
 void SemanticAnalyzer::popScope() {
-    if (!scopes.empty()) {
-        scopes.pop_back();
+    if (scopeStarts.empty()) {
+        return;
+    }
+    // Unwind in reverse so each name gets back the declaration it shadowed
+    while (symbols.size() > scopeStarts.back()) {
+        innermost[symbols.back().symbol.id] = symbols.back().shadowed;
+        symbols.pop_back();
     }
+    scopeStarts.pop_back();
 }
 
-void SemanticAnalyzer::declareVariable(const std::string& name, const Symbol& symbol) {
-    if (scopes.empty()) {
+void SemanticAnalyzer::declareVariable(const Symbol& symbol) {
+    if (scopeStarts.empty()) {
         pushScope();
     }
-    scopes.back()[name] = symbol;
+    symbols.push_back({symbol, innermost[symbol.id]});
+    innermost[symbol.id] = static_cast<int>(symbols.size() - 1);
 }
 
-Symbol* SemanticAnalyzer::lookupVariable(const std::string& name) {
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-        auto found = it->find(name);
-        if (found != it->end()) {
-            return &found->second;
-        }
-    }
-    return nullptr;
+bool SemanticAnalyzer::isDeclaredInScope(IdentifierId id) const {
+    return !scopeStarts.empty() && innermost[id] >= 0 &&
+           static_cast<size_t>(innermost[id]) >= scopeStarts.back();
 }
 
-FunctionInfo* SemanticAnalyzer::lookupFunction(const std::string& name) {
-    auto it = functions.find(name);
+Symbol* SemanticAnalyzer::lookupVariable(IdentifierId id) {
+    int index = innermost[id];
+    return index >= 0 ? &symbols[index].symbol : nullptr;
+}
+
+FunctionInfo* SemanticAnalyzer::lookupFunction(IdentifierId id) {
+    auto it = functions.find(id);
     if (it != functions.end()) {
         return &it->second;
     }
     return nullptr;
 }
 
+void SemanticAnalyzer::addFunction(std::string_view name, const FunctionInfo& info) {
+    IdentifierId id = identifiers.lookup(name);
+    if (id != NoIdentifier) {
+        functions[id] = info;
+    }
+}
+
+void SemanticAnalyzer::addBuiltin(Builtin builtin, FunctionInfo info) {
+    info.binding = Binding(Binding::Kind::BUILTIN, static_cast<uint32_t>(builtin));
+    addFunction(getBuiltinName(builtin), info);
+}
+
 void SemanticAnalyzer::error(const std::string& message, int line, int column) {
     std::ostringstream oss;
     if (line >= 0) {
@@ -691,12 +843,12 @@ void SemanticAnalyzer::warning(const std::string& message, int line, int column)
     structuredWarnings.emplace_back(message, line, column);
 }
 
-bool SemanticAnalyzer::typesMatch(const std::shared_ptr<Type>& t1, const std::shared_ptr<Type>& t2) {
-    if (!t1 || !t2) return false;
-    return t1->kind == t2->kind;
+bool SemanticAnalyzer::typesMatch(const Type* t1, const Type* t2) {
+    // Types are unique, see TypeContext
+    return t1 && t1 == t2;
 }
 
-std::string SemanticAnalyzer::typeToString(const std::shared_ptr<Type>& type) {
+std::string SemanticAnalyzer::typeToString(const Type* type) {
     if (!type) return "unknown";
     
     switch (type->kind) {
@@ -717,7 +869,7 @@ std::string SemanticAnalyzer::typeToString(const std::shared_ptr<Type>& type) {
     }
 }
 
-std::shared_ptr<Type> SemanticAnalyzer::getCommonType(const std::shared_ptr<Type>& t1, const std::shared_ptr<Type>& t2) {
+const Type* SemanticAnalyzer::getCommonType(const Type* t1, const Type* t2) {
     if (!t1 || !t2) return Type::getI32();
     
     // If same type, return it
@@ -725,26 +877,26 @@ std::shared_ptr<Type> SemanticAnalyzer::getCommonType(const std::shared_ptr<Type
     
     // Float promotion
     if (t1->kind == Type::Kind::F64 || t2->kind == Type::Kind::F64) return Type::getF64();
-    if (t1->kind == Type::Kind::F32 || t2->kind == Type::Kind::F32) return std::make_shared<Type>(Type::Kind::F32);
+    if (t1->kind == Type::Kind::F32 || t2->kind == Type::Kind::F32) return Type::get(Type::Kind::F32);
     
     // Integer promotion (return larger type)
     return Type::getI64();
 }
 
 void SemanticAnalyzer::markSideEffect(const std::string& reason) {
-    currentFunctionHasSideEffects = true;
+    currentFunction.hasSideEffects = true;
 }
 
 void SemanticAnalyzer::checkPureFunction(FunctionDecl& node) {
     // This is called during analysis - pure functions are checked automatically
 }
 
-void SemanticAnalyzer::checkPureLocalAccess(const std::string& varName, int line, int column) {
-    Symbol* symbol = lookupVariable(varName);
-    if (symbol && symbol->isPureLocal && currentFunction && !currentFunction->isPure) {
+void SemanticAnalyzer::checkPureLocalAccess(IdentifierId id, const std::string& varName, int line, int column) {
+    Symbol* symbol = lookupVariable(id);
+    if (symbol && symbol->isPureLocal && currentFunction.info && !currentFunction.info->isPure) {
         ErrorInfo err("Cannot access pure_local variable '" + varName + "' from non-pure function", line, column);
         err.suggestion = "Pure_local variables can only be accessed by pure functions. Either make function '" + 
-                         currentFunction->name + "' pure by adding the 'pure' keyword, or remove 'pure_local' from variable '" + 
+                         currentFunction.info->name + "' pure by adding the 'pure' keyword, or remove 'pure_local' from variable '" + 
                          varName + "'.";
         structuredErrors.push_back(err);
     }
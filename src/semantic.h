@@ -2,36 +2,40 @@
 #define HASH_SEMANTIC_H
 
 #include "ast.h"
+#include "builtins.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace hash {
 
 // Symbol information
 struct Symbol {
-    std::string name;
-    std::shared_ptr<Type> type;
+    IdentifierId id;
+    const Type* type;
     bool isMutable;
     bool isPureLocal;
     bool isParameter;
+    Binding binding; // LOCAL or GLOBAL
     
-    Symbol() : name(""), type(nullptr), isMutable(false), isPureLocal(false), isParameter(false) {}
-    Symbol(const std::string& n, std::shared_ptr<Type> t, bool mut = false, bool pureLocal = false, bool param = false)
-        : name(n), type(t), isMutable(mut), isPureLocal(pureLocal), isParameter(param) {}
+    Symbol() : id(NoIdentifier), type(nullptr), isMutable(false), isPureLocal(false), isParameter(false) {}
+    Symbol(IdentifierId id, const Type* t, bool mut = false, bool pureLocal = false, bool param = false)
+        : id(id), type(t), isMutable(mut), isPureLocal(pureLocal), isParameter(param) {}
 };
 
 // Function information
 struct FunctionInfo {
     std::string name;
-    std::shared_ptr<Type> returnType;
-    std::vector<std::shared_ptr<Type>> paramTypes;
+    const Type* returnType;
+    std::vector<const Type*> paramTypes;
     bool isPure;
     bool hasSideEffects; // Analyzed during semantic analysis
+    Binding binding;     // What calls to it resolve to; set by SemanticAnalyzer
     
     FunctionInfo() : name(""), returnType(nullptr), isPure(false), hasSideEffects(false) {}
-    FunctionInfo(const std::string& n, std::shared_ptr<Type> ret, bool pure = false)
+    FunctionInfo(const std::string& n, const Type* ret, bool pure = false)
         : name(n), returnType(ret), isPure(pure), hasSideEffects(false) {}
 };
 
@@ -49,9 +53,18 @@ public:
             : message(msg), line(l), column(c), length(len), suggestion("") {}
     };
     
-    SemanticAnalyzer();
+    // Names are resolved through identifiers, which must already hold every
+    // identifier of the program and is only read
+    explicit SemanticAnalyzer(const IdentifierTable& identifiers);
     
     bool analyze(Program& program);
+    // Function bodies are analyzed on this many threads, 0 for all cores.
+    // Programs with few functions use fewer, as a thread only pays for
+    // itself over a few dozen bodies. Diagnostics do not depend on it.
+    void setThreads(unsigned count) { threads = count; }
+    // Makes the exported functions of an imported module callable. Must be
+    // called before analyze().
+    void addImportedFunctions(const std::vector<FunctionInfo>& imported);
     const std::vector<std::string>& getErrors() const { return errors; }
     const std::vector<std::string>& getWarnings() const { return warnings; }
     const std::vector<ErrorInfo>& getStructuredErrors() const { return structuredErrors; }
@@ -78,33 +91,99 @@ public:
     void visit(Program& node) override;
     
 private:
-    std::vector<std::unordered_map<std::string, Symbol>> scopes;
-    std::unordered_map<std::string, FunctionInfo> functions;
+    // A worker analyzing function bodies for parent. It shares the parent's
+    // function table, which stays unchanged while workers run, and starts
+    // from a copy of its global scope.
+    explicit SemanticAnalyzer(const SemanticAnalyzer& parent);
+    
+    const IdentifierTable& identifiers;
+    const std::string& getName(IdentifierId id) const { return identifiers.getName(id); }
+    
+    // Every variable in scope, in declaration order. A declaration links to
+    // the one of the same name it shadows, and innermost holds the newest
+    // declaration of each identifier, so a lookup is one array access and
+    // scopes allocate nothing. scopeStarts marks where each scope begins.
+    struct ScopedSymbol {
+        Symbol symbol;
+        int shadowed; // Index of the outer declaration, or -1
+    };
+    std::vector<ScopedSymbol> symbols;
+    std::vector<int> innermost; // Indexed by IdentifierId, -1 if undeclared
+    std::vector<size_t> scopeStarts;
+    
+    std::unordered_map<IdentifierId, FunctionInfo> ownFunctions;
+    std::unordered_map<IdentifierId, FunctionInfo>& functions; // ownFunctions, or the parent's
+    std::vector<FunctionInfo> importedFunctions;
     std::vector<std::string> errors;
     std::vector<std::string> warnings;
     std::vector<ErrorInfo> structuredErrors;
     std::vector<ErrorInfo> structuredWarnings;
     
-    FunctionInfo* currentFunction;
-    bool currentFunctionHasSideEffects;
-    std::unordered_set<std::string> modifiedVariables; // Track variables modified in current function
+    unsigned threads = 0;
+    uint32_t globalCount;
+    
+    // A call to a function of this program. Whether the callee has side
+    // effects is only known once the bodies before the caller's have been
+    // analyzed, so the call is settled afterwards by mergeBody().
+    struct PendingCall {
+        const FunctionInfo* callee;
+        int line;
+        int column;
+        size_t errorIndex; // Where in the body's structured errors a purity error goes
+    };
+    
+    // State of the function body being analyzed
+    struct FunctionContext {
+        FunctionInfo* info = nullptr; // Null outside function bodies
+        bool hasSideEffects = false;
+        uint32_t localCount = 0; // Slots handed out so far
+        std::unordered_set<IdentifierId> modifiedVariables;
+        std::vector<PendingCall> calls;
+    };
+    FunctionContext currentFunction;
+    // Walks the expressions of statements; a worker starts with its own
+    ExpressionWalker walker;
+    
+    // What analyzing one body produced, kept apart until bodies are merged
+    struct BodyResult {
+        std::vector<std::string> errors;
+        std::vector<std::string> warnings;
+        std::vector<ErrorInfo> structuredErrors;
+        std::vector<ErrorInfo> structuredWarnings;
+        bool hasSideEffects = false;
+        std::vector<PendingCall> calls;
+    };
+    
+    // Analyzes every function body, in parallel where worthwhile, and merges
+    // the results in source order
+    void analyzeBodies(Program& program);
+    BodyResult analyzeBody(FunctionDecl& function);
+    // Settles the body's calls against the bodies merged before it and adds
+    // its diagnostics
+    void mergeBody(FunctionDecl& function, BodyResult& result);
     
     void pushScope();
     void popScope();
-    void declareVariable(const std::string& name, const Symbol& symbol);
-    Symbol* lookupVariable(const std::string& name);
-    FunctionInfo* lookupFunction(const std::string& name);
+    void declareVariable(const Symbol& symbol);
+    // Whether id is declared in the innermost scope
+    bool isDeclaredInScope(IdentifierId id) const;
+    Symbol* lookupVariable(IdentifierId id);
+    FunctionInfo* lookupFunction(IdentifierId id);
+    // Registers a function known by name, such as an import. Names that no
+    // module mentions are skipped, since nothing can call them.
+    void addFunction(std::string_view name, const FunctionInfo& info);
+    void addBuiltin(Builtin builtin, FunctionInfo info);
     
     void error(const std::string& message, int line = -1, int column = -1);
     void warning(const std::string& message, int line = -1, int column = -1);
     
-    std::string typeToString(const std::shared_ptr<Type>& type);
-    bool typesMatch(const std::shared_ptr<Type>& t1, const std::shared_ptr<Type>& t2);
-    std::shared_ptr<Type> getCommonType(const std::shared_ptr<Type>& t1, const std::shared_ptr<Type>& t2);
+    std::string typeToString(const Type* type);
+    bool typesMatch(const Type* t1, const Type* t2);
+    const Type* getCommonType(const Type* t1, const Type* t2);
     
     // Behavior-aware analysis
     void checkPureFunction(FunctionDecl& node);
-    void checkPureLocalAccess(const std::string& varName, int line, int column);
+    void checkPureLocalAccess(IdentifierId id, const std::string& varName, int line, int column);
     void markSideEffect(const std::string& reason);
 };
 
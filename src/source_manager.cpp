@@ -0,0 +1,110 @@
+#include "source_manager.h"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hash {
+
+namespace {
+
+// Maps a regular, non-empty file read-only. Anything else (pipes, devices,
+// empty files) fails here and is read instead.
+bool mapFile(const std::string& path, void*& data, size_t& size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool mapped = false;
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            // The view keeps the mapping alive after its handle is closed
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (view) {
+                data = view;
+                size = static_cast<size_t>(fileSize.QuadPart);
+                mapped = true;
+            }
+        }
+    }
+    CloseHandle(file);
+    return mapped;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool mapped = false;
+    struct stat status;
+    if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            data = view;
+            size = static_cast<size_t>(status.st_size);
+            mapped = true;
+        }
+    }
+    close(fd);
+    return mapped;
+#endif
+}
+
+void unmapFile(void* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+} // namespace
+
+SourceFile::~SourceFile() {
+    if (mapping) {
+        unmapFile(mapping, mappingSize);
+    }
+}
+
+const SourceFile* SourceManager::load(const std::string& path) {
+    for (const auto& file : files) {
+        if (file->path == path) {
+            return file.get();
+        }
+    }
+
+    std::unique_ptr<SourceFile> file(new SourceFile(path));
+    if (path != "-" && mapFile(path, file->mapping, file->mappingSize)) {
+        file->text = std::string_view(static_cast<const char*>(file->mapping), file->mappingSize);
+    } else if (path == "-") {
+        file->buffer.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        file->text = file->buffer;
+    } else {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream.is_open()) {
+            return nullptr;
+        }
+        file->buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        file->text = file->buffer;
+    }
+
+    files.push_back(std::move(file));
+    return files.back().get();
+}
+
+} // namespace hash
@@ -0,0 +1,47 @@
+#ifndef HASH_SOURCE_MANAGER_H
+#define HASH_SOURCE_MANAGER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hash {
+
+// The text of one input file. Regular files are memory-mapped; stdin,
+// pipes and anything else that can't be mapped are read into memory. The
+// text never moves while the SourceFile is alive, so tokens, the parser
+// and diagnostics all share views into it instead of copies.
+class SourceFile {
+public:
+    ~SourceFile();
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    const std::string& getPath() const { return path; }
+    std::string_view getText() const { return text; }
+
+private:
+    friend class SourceManager;
+    explicit SourceFile(const std::string& path) : path(path) {}
+
+    std::string path;
+    std::string_view text;
+    void* mapping = nullptr;  // Start of the mapped view, if mapped
+    size_t mappingSize = 0;
+    std::string buffer;       // The text, when it was read instead
+};
+
+// Owns every source file of one compilation and loads each only once
+class SourceManager {
+public:
+    // The file at path, "-" for stdin; null if it can't be read
+    const SourceFile* load(const std::string& path);
+
+private:
+    std::vector<std::unique_ptr<SourceFile>> files;
+};
+
+} // namespace hash
+
+#endif // HASH_SOURCE_MANAGER_H